@@ -0,0 +1,274 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "diskstats.h"
+#include "procfile.h"
+#include "rpiInfo.h"
+#include "nospawn.h"
+
+/*
+ * Block device throughput, IOPS, latency and utilization from /proc/diskstats.
+ *
+ * Only the devices named in DISK_DEVICES are tracked. /proc/diskstats lists
+ * every loop device and partition too, so each line is rejected after
+ * comparing its name field, before any number is parsed; the file is read in
+ * buffer-sized windows however many devices the system has. Utilization is the
+ * growth of io_ticks (milliseconds with I/O in flight) over the interval, the
+ * same figure iostat reports as %util. Latency is the growth of the time spent
+ * reading (or writing) over the number of reads (writes) completed, iostat's
+ * r_await and w_await.
+ *
+ * DiskStatsSample() runs on the sampler thread, DiskStatsGet() on the
+ * renderer; the table is guarded by a mutex held only while copying or
+ * updating it.
+ */
+
+// /proc/diskstats counts 512-byte sectors regardless of the device's block size
+#define DISKSTATS_SECTOR_BYTES 512
+
+static ProcFile procDiskstats = PROCFILE_INIT("/proc/diskstats");
+static DiskStats disks[DISKSTATS_MAX];
+static uint8_t diskCount = 0;
+static uint8_t diskSeen[DISKSTATS_MAX];
+static struct timespec diskSampled;
+static uint8_t diskSampledValid = 0;
+static pthread_mutex_t diskLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Fill the device table from DISK_DEVICES.
+ *
+ * @return void
+ */
+static void DiskStatsConfigure(void)
+{
+  const char *p = DISK_DEVICES;
+  const char *end;
+  size_t len = 0;
+
+  while ((*p != '\0') && (diskCount < DISKSTATS_MAX))
+  {
+    end = strchr(p, ',');
+    len = (end != NULL) ? (size_t)(end - p) : strlen(p);
+    if ((len > 0) && (len < DISKSTATS_NAME_MAX))
+    {
+      memcpy(disks[diskCount].name, p, len);
+      disks[diskCount].name[len] = '\0';
+      diskCount++;
+    }
+    p += len;
+    if (*p == ',')
+    {
+      p++;
+    }
+  }
+}
+
+/**
+ * @brief Rate per second of a counter over an interval.
+ *
+ * @param delta Counter growth.
+ * @param ns Interval in nanoseconds.
+ * @return Rate.
+ */
+static uint64_t DiskStatsRate(uint64_t delta, uint64_t ns)
+{
+  return (ns > 0) ? (uint64_t)((double)delta * 1e9 / ns) : 0;
+}
+
+/**
+ * @brief Average time per I/O completed over an interval.
+ *
+ * @param ms Milliseconds spent on I/O in this direction.
+ * @param prevMs The same at the previous sample.
+ * @param ios I/Os completed in this direction.
+ * @param prevIos The same at the previous sample.
+ * @return Microseconds per I/O, 0 if none completed or a counter wrapped.
+ */
+static uint32_t DiskStatsAwait(uint64_t ms, uint64_t prevMs, uint64_t ios, uint64_t prevIos)
+{
+  uint64_t us = 0;
+
+  if ((ms < prevMs) || (ios <= prevIos))
+  {
+    return 0;
+  }
+  us = (ms - prevMs) * 1000 / (ios - prevIos);
+  return (us > UINT32_MAX) ? UINT32_MAX : us;
+}
+
+/**
+ * @brief Update one configured device from its /proc/diskstats line.
+ *
+ * Lines are "major minor name reads merged sectors ms writes merged sectors
+ * ms in_flight io_ticks ...".
+ *
+ * @param line One line, NUL-terminated.
+ * @param len Length of the line.
+ * @param ctx Interval since the previous sample in nanoseconds (uint64_t *).
+ * @return void
+ */
+static void DiskStatsParseLine(char *line, size_t len, void *ctx)
+{
+  uint64_t ns = *(const uint64_t *)ctx;
+  uint64_t f[10] = {0};
+  const char *p = line;
+  const char *name;
+  size_t nameLen = 0;
+  DiskStats *disk = NULL;
+  uint8_t i = 0;
+  uint8_t index = 0;
+
+  // skip major and minor
+  for (i = 0; i < 2; i++)
+  {
+    while (*p == ' ')
+    {
+      p++;
+    }
+    while ((*p != ' ') && (*p != '\0'))
+    {
+      p++;
+    }
+  }
+  while (*p == ' ')
+  {
+    p++;
+  }
+  name = p;
+  while ((*p != ' ') && (*p != '\0'))
+  {
+    p++;
+  }
+  nameLen = p - name;
+
+  for (i = 0; i < diskCount; i++)
+  {
+    if ((strncmp(disks[i].name, name, nameLen) == 0) && (disks[i].name[nameLen] == '\0'))
+    {
+      disk = &disks[i];
+      index = i;
+      break;
+    }
+  }
+  if (disk == NULL)
+  {
+    return;
+  }
+
+  for (i = 0; i < 10; i++)
+  {
+    p = ParseUnsigned(p, &f[i]);
+    if (p == NULL)
+    {
+      return;
+    }
+  }
+
+  // a device that just appeared (or was re-created) has no previous counters to rate against
+  if (disk->present && (ns > 0) && (f[0] >= disk->reads) && (f[2] >= disk->sectorsRead) &&
+      (f[4] >= disk->writes) && (f[6] >= disk->sectorsWritten) && (f[9] >= disk->ioTicks))
+  {
+    disk->readIops = DiskStatsRate(f[0] - disk->reads, ns);
+    disk->readBytesRate = DiskStatsRate((f[2] - disk->sectorsRead) * DISKSTATS_SECTOR_BYTES, ns);
+    disk->writeIops = DiskStatsRate(f[4] - disk->writes, ns);
+    disk->writeBytesRate = DiskStatsRate((f[6] - disk->sectorsWritten) * DISKSTATS_SECTOR_BYTES, ns);
+    disk->utilPct = ((f[9] - disk->ioTicks) * 1000000 >= ns) ? 100 : (f[9] - disk->ioTicks) * 100000000 / ns;
+    // the ms counters are 32 bits on some kernels and wrap after 49 days
+    disk->readAwaitUs = DiskStatsAwait(f[3], disk->readMs, f[0], disk->reads);
+    disk->writeAwaitUs = DiskStatsAwait(f[7], disk->writeMs, f[4], disk->writes);
+  }
+  else
+  {
+    disk->readIops = 0;
+    disk->readBytesRate = 0;
+    disk->writeIops = 0;
+    disk->writeBytesRate = 0;
+    disk->utilPct = 0;
+    disk->readAwaitUs = 0;
+    disk->writeAwaitUs = 0;
+  }
+  disk->reads = f[0];
+  disk->sectorsRead = f[2];
+  disk->readMs = f[3];
+  disk->writes = f[4];
+  disk->sectorsWritten = f[6];
+  disk->writeMs = f[7];
+  disk->ioTicks = f[9];
+  disk->present = 1;
+  diskSeen[index] = 1;
+}
+
+/**
+ * @brief Read /proc/diskstats and update the configured devices.
+ *
+ * @return Number of configured devices present, 0 on failure.
+ */
+uint8_t DiskStatsSample(void)
+{
+  struct timespec now;
+  DiskStats gone;
+  uint64_t ns = 0;
+  uint8_t present = 0;
+  uint8_t i = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  pthread_mutex_lock(&diskLock);
+  if (diskCount == 0)
+  {
+    DiskStatsConfigure();
+  }
+  if (diskSampledValid)
+  {
+    ns = (now.tv_sec - diskSampled.tv_sec) * 1000000000ULL + now.tv_nsec - diskSampled.tv_nsec;
+  }
+
+  memset(diskSeen, 0, sizeof(diskSeen));
+  if (ProcFileForEachLine(&procDiskstats, DiskStatsParseLine, &ns) == 0)
+  {
+    for (i = 0; i < diskCount; i++)
+    {
+      if (diskSeen[i])
+      {
+        present++;
+      }
+      else
+      {
+        // device removed, keep only its name
+        gone = (DiskStats){0};
+        strcpy(gone.name, disks[i].name);
+        disks[i] = gone;
+      }
+    }
+    diskSampled = now;
+    diskSampledValid = 1;
+  }
+  pthread_mutex_unlock(&diskLock);
+  return present;
+}
+
+/**
+ * @brief Copy the counters and rates of one configured device.
+ *
+ * @param index Position in DISK_DEVICES.
+ * @param stats Destination.
+ * @return 0 on success, 1 past the end of the list.
+ */
+uint8_t DiskStatsGet(uint8_t index, DiskStats *stats)
+{
+  uint8_t ret = 1;
+
+  pthread_mutex_lock(&diskLock);
+  if (diskCount == 0)
+  {
+    DiskStatsConfigure();
+  }
+  if (index < diskCount)
+  {
+    *stats = disks[index];
+    ret = 0;
+  }
+  pthread_mutex_unlock(&diskLock);
+  return ret;
+}
@@ -0,0 +1,37 @@
+#ifndef __DISKSTATS_H
+#define __DISKSTATS_H
+
+#include <stdint.h>
+
+// Block devices tracked from DISK_DEVICES; further ones are ignored
+#define DISKSTATS_MAX 8
+#define DISKSTATS_NAME_MAX 32
+
+// Counters and rates of one block device
+typedef struct DiskStats
+{
+  char name[DISKSTATS_NAME_MAX];
+  uint8_t present;
+  uint64_t reads;
+  uint64_t sectorsRead;
+  uint64_t readMs;
+  uint64_t writes;
+  uint64_t sectorsWritten;
+  uint64_t writeMs;
+  uint64_t ioTicks;
+  // per second, over the last sampling interval
+  uint64_t readBytesRate;
+  uint64_t writeBytesRate;
+  uint32_t readIops;
+  uint32_t writeIops;
+  // average time per read and per write completed in the interval, like iostat's r_await and w_await
+  uint32_t readAwaitUs;
+  uint32_t writeAwaitUs;
+  // share of the interval the device had I/O in flight
+  uint8_t utilPct;
+} DiskStats;
+
+uint8_t DiskStatsSample(void);
+uint8_t DiskStatsGet(uint8_t index, DiskStats *stats);
+
+#endif /*__DISKSTATS_H*/
@@ -0,0 +1,313 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include "eventloop.h"
+#include "nospawn.h"
+
+/*
+ * A single-threaded epoll loop over timers, descriptors and signals.
+ *
+ * Timers are timerfds armed on an absolute CLOCK_MONOTONIC deadline with a
+ * kernel-side period. The kernel advances each expiry from the previous
+ * deadline, not from when the handler ran, so the cadence does not drift with
+ * the time spent handling it; an overrun shows up as an expiration count
+ * above one instead of shifting every later tick. Signals are read from a
+ * signalfd, so handlers run in the loop's thread and may do anything.
+ */
+
+enum
+{
+  EVENT_FD = 0,
+  EVENT_TIMER,
+  EVENT_SIGNAL
+};
+
+/**
+ * @brief Create the epoll instance.
+ *
+ * @param loop Loop to initialize.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t EventLoopInit(EventLoop *loop)
+{
+  memset(loop, 0, sizeof(*loop));
+  loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (loop->epfd < 0)
+  {
+    fprintf(stderr, "rpiInfo: Unable to create event loop.\n");
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Register a descriptor of the given kind with the loop.
+ *
+ * @param loop Event loop.
+ * @param fd Descriptor to watch.
+ * @param events epoll events to wait for.
+ * @param kind EVENT_FD, EVENT_TIMER or EVENT_SIGNAL.
+ * @param fn Handler.
+ * @param ctx Passed through to the handler.
+ * @return fd on success, -1 on failure.
+ */
+static int EventLoopAdd(EventLoop *loop, int fd, uint32_t events, uint8_t kind, EventHandler fn, void *ctx)
+{
+  struct epoll_event ev;
+  EventSource *src;
+
+  if (loop->count == EVENTLOOP_MAX)
+  {
+    fprintf(stderr, "rpiInfo: Too many event sources.\n");
+    return -1;
+  }
+
+  src = &loop->sources[loop->count];
+  src->fd = fd;
+  src->kind = kind;
+  src->fn = fn;
+  src->ctx = ctx;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events;
+  ev.data.ptr = src;
+  if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+  {
+    fprintf(stderr, "rpiInfo: Unable to watch event source.\n");
+    return -1;
+  }
+  loop->count++;
+  return fd;
+}
+
+/**
+ * @brief Time since a periodic timer's latest expiry was due.
+ *
+ * Measured from the kernel's schedule, so called from the timer's handler it
+ * gives how late the handler is running, including any time it has spent.
+ *
+ * @param fd timerfd returned by EventLoopAddTimer().
+ * @return Microseconds, -1 for a one-shot or failed timer.
+ */
+int64_t EventLoopTimerLateUs(int fd)
+{
+  struct itimerspec its;
+  int64_t interval = 0;
+  int64_t remaining = 0;
+
+  if (timerfd_gettime(fd, &its) < 0)
+  {
+    return -1;
+  }
+  interval = its.it_interval.tv_sec * 1000000LL + its.it_interval.tv_nsec / 1000;
+  remaining = its.it_value.tv_sec * 1000000LL + its.it_value.tv_nsec / 1000;
+  if (interval == 0)
+  {
+    return -1;
+  }
+  // the next expiry is one period after the one that was due
+  return interval - remaining;
+}
+
+/**
+ * @brief Call a handler whenever a descriptor is ready.
+ *
+ * The loop does not read the descriptor; the handler must consume whatever
+ * made it ready, or it is called again.
+ *
+ * @param loop Event loop.
+ * @param fd Descriptor to watch, owned by the caller.
+ * @param events epoll events to wait for (EPOLLIN, EPOLLPRI, ...).
+ * @param fn Handler, called with the events that occurred.
+ * @param ctx Passed through to the handler.
+ * @return fd on success, -1 on failure.
+ */
+int EventLoopAddFd(EventLoop *loop, int fd, uint32_t events, EventHandler fn, void *ctx)
+{
+  return EventLoopAdd(loop, fd, events, EVENT_FD, fn, ctx);
+}
+
+/**
+ * @brief Call a handler on a fixed cadence.
+ *
+ * @param loop Event loop.
+ * @param delayMs Time until the first expiry.
+ * @param intervalMs Period after that, 0 for a one-shot timer.
+ * @param fn Handler, called with the number of expiries since the last call.
+ * @param ctx Passed through to the handler.
+ * @return timerfd on success, -1 on failure.
+ */
+int EventLoopAddTimer(EventLoop *loop, uint32_t delayMs, uint32_t intervalMs, EventHandler fn, void *ctx)
+{
+  struct itimerspec its;
+  int fd = -1;
+
+  fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0)
+  {
+    fprintf(stderr, "rpiInfo: Unable to create timer.\n");
+    return -1;
+  }
+
+  // an absolute first deadline, then the kernel keeps the period
+  memset(&its, 0, sizeof(its));
+  clock_gettime(CLOCK_MONOTONIC, &its.it_value);
+  its.it_value.tv_nsec += (delayMs % 1000) * 1000000L;
+  its.it_value.tv_sec += delayMs / 1000 + its.it_value.tv_nsec / 1000000000L;
+  its.it_value.tv_nsec %= 1000000000L;
+  its.it_interval.tv_sec = intervalMs / 1000;
+  its.it_interval.tv_nsec = (intervalMs % 1000) * 1000000L;
+  if ((timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) ||
+      (EventLoopAdd(loop, fd, EPOLLIN, EVENT_TIMER, fn, ctx) < 0))
+  {
+    fprintf(stderr, "rpiInfo: Unable to arm timer.\n");
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * @brief Handle signals in the loop instead of asynchronously.
+ *
+ * Blocks the signals in the calling thread. Threads created afterwards
+ * inherit the mask, so call this before starting any, or the default action
+ * may still be taken on one of them.
+ *
+ * @param loop Event loop.
+ * @param set Signals to handle.
+ * @param fn Handler, called once per signal with its number.
+ * @param ctx Passed through to the handler.
+ * @return signalfd on success, -1 on failure.
+ */
+int EventLoopAddSignals(EventLoop *loop, const sigset_t *set, EventHandler fn, void *ctx)
+{
+  int fd = -1;
+
+  pthread_sigmask(SIG_BLOCK, set, NULL);
+  fd = signalfd(-1, set, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (fd < 0)
+  {
+    fprintf(stderr, "rpiInfo: Unable to create signalfd.\n");
+    return -1;
+  }
+  if (EventLoopAdd(loop, fd, EPOLLIN, EVENT_SIGNAL, fn, ctx) < 0)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * @brief Read what made a timer or signal source ready and call its handler.
+ *
+ * @param loop Event loop.
+ * @param src Ready source.
+ * @param events epoll events that occurred.
+ * @return void
+ */
+static void EventLoopDispatch(EventLoop *loop, EventSource *src, uint32_t events)
+{
+  struct signalfd_siginfo si;
+  uint64_t expirations = 0;
+
+  switch (src->kind)
+  {
+  case EVENT_TIMER:
+    // EAGAIN when the timer was re-armed between epoll_wait() and here
+    if (read(src->fd, &expirations, sizeof(expirations)) == sizeof(expirations))
+    {
+      src->fn(loop, expirations, src->ctx);
+    }
+    break;
+  case EVENT_SIGNAL:
+    while (read(src->fd, &si, sizeof(si)) == sizeof(si))
+    {
+      src->fn(loop, si.ssi_signo, src->ctx);
+    }
+    break;
+  default:
+    src->fn(loop, events, src->ctx);
+    break;
+  }
+}
+
+/**
+ * @brief Wait for and dispatch events until a handler calls EventLoopStop().
+ *
+ * @param loop Event loop.
+ * @return void
+ */
+void EventLoopRun(EventLoop *loop)
+{
+  struct epoll_event evs[EVENTLOOP_MAX];
+  int n = 0;
+  int i = 0;
+
+  loop->running = 1;
+  while (loop->running)
+  {
+    n = epoll_wait(loop->epfd, evs, EVENTLOOP_MAX, -1);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      fprintf(stderr, "rpiInfo: Event loop wait failed.\n");
+      break;
+    }
+    for (i = 0; (i < n) && loop->running; i++)
+    {
+      EventLoopDispatch(loop, evs[i].data.ptr, evs[i].events);
+    }
+  }
+}
+
+/**
+ * @brief Make EventLoopRun() return once the current handler finishes.
+ *
+ * Only call this from a handler of the same loop; other threads wake it
+ * through a descriptor it watches.
+ *
+ * @param loop Event loop.
+ * @return void
+ */
+void EventLoopStop(EventLoop *loop)
+{
+  loop->running = 0;
+}
+
+/**
+ * @brief Close the epoll instance and the timers and signalfds the loop created.
+ *
+ * Descriptors added with EventLoopAddFd() stay open.
+ *
+ * @param loop Event loop.
+ * @return void
+ */
+void EventLoopClose(EventLoop *loop)
+{
+  uint8_t i = 0;
+
+  for (i = 0; i < loop->count; i++)
+  {
+    if (loop->sources[i].kind != EVENT_FD)
+    {
+      close(loop->sources[i].fd);
+    }
+  }
+  loop->count = 0;
+  if (loop->epfd >= 0)
+  {
+    close(loop->epfd);
+    loop->epfd = -1;
+  }
+}
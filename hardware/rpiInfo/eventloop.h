@@ -0,0 +1,40 @@
+#ifndef __EVENTLOOP_H
+#define __EVENTLOOP_H
+
+#include <signal.h>
+#include <stdint.h>
+
+// Timers, descriptors and signal sets one loop can watch
+#define EVENTLOOP_MAX 8
+
+typedef struct EventLoop EventLoop;
+
+// Called with the epoll events of a descriptor, the expirations of a timer or the number of a signal
+typedef void (*EventHandler)(EventLoop *loop, uint64_t value, void *ctx);
+
+typedef struct EventSource
+{
+  int fd;
+  uint8_t kind;
+  EventHandler fn;
+  void *ctx;
+} EventSource;
+
+typedef struct EventLoop
+{
+  int epfd;
+  uint8_t running;
+  uint8_t count;
+  EventSource sources[EVENTLOOP_MAX];
+} EventLoop;
+
+uint8_t EventLoopInit(EventLoop *loop);
+int EventLoopAddFd(EventLoop *loop, int fd, uint32_t events, EventHandler fn, void *ctx);
+int EventLoopAddTimer(EventLoop *loop, uint32_t delayMs, uint32_t intervalMs, EventHandler fn, void *ctx);
+int64_t EventLoopTimerLateUs(int fd);
+int EventLoopAddSignals(EventLoop *loop, const sigset_t *set, EventHandler fn, void *ctx);
+void EventLoopRun(EventLoop *loop);
+void EventLoopStop(EventLoop *loop);
+void EventLoopClose(EventLoop *loop);
+
+#endif /*__EVENTLOOP_H*/
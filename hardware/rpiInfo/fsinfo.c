@@ -0,0 +1,254 @@
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/statvfs.h>
+#include "fsinfo.h"
+#include "procfile.h"
+#include "rpiInfo.h"
+#include "nospawn.h"
+
+/*
+ * Filesystem usage without df(1).
+ *
+ * The mount table is read from /proc/self/mountinfo only at startup and when
+ * poll() flags the file with POLLPRI, which the kernel does whenever a mount
+ * or unmount happens in our namespace. The table is only used to tell whether
+ * each configured mount point is currently mounted (statvfs() on an unmounted
+ * directory would silently report the parent filesystem); usage itself comes
+ * from one statvfs() per mount point per update.
+ */
+
+static ProcFile procMountinfo = PROCFILE_INIT("/proc/self/mountinfo");
+static FSUsage fsMounts[FS_MOUNT_MAX];
+static uint8_t fsMountCount = 0;
+static uint8_t fsTableValid = 0;
+
+/**
+ * @brief Fill the tracked mount list from "/" and FS_MOUNT_POINTS.
+ *
+ * @return void
+ */
+static void FSInfoConfigure(void)
+{
+  const char *p = FS_MOUNT_POINTS;
+  const char *end;
+  size_t len = 0;
+
+  strcpy(fsMounts[0].mountPoint, "/");
+  fsMountCount = 1;
+
+  while ((*p != '\0') && (fsMountCount < FS_MOUNT_MAX))
+  {
+    end = strchr(p, ',');
+    len = (end != NULL) ? (size_t)(end - p) : strlen(p);
+    if ((len > 0) && (len < FS_PATH_MAX) && !((len == 1) && (*p == '/')))
+    {
+      memcpy(fsMounts[fsMountCount].mountPoint, p, len);
+      fsMounts[fsMountCount].mountPoint[len] = '\0';
+      fsMountCount++;
+    }
+    else if (len >= FS_PATH_MAX)
+    {
+      fprintf(stderr, "rpiInfo: Ignoring mount point longer than %u characters.\n", FS_PATH_MAX - 1);
+    }
+    p += len;
+    if (*p == ',')
+    {
+      p++;
+    }
+  }
+}
+
+/**
+ * @brief Mark the tracked mount points that appear on one mountinfo line.
+ *
+ * The mount point is the fifth field, with blanks and backslashes escaped as
+ * three-digit octal sequences.
+ *
+ * @param line One line of /proc/self/mountinfo, without the newline.
+ * @param len Length of the line.
+ * @param ctx Unused.
+ * @return void
+ */
+static void FSInfoParseLine(char *line, size_t len, void *ctx)
+{
+  const char *p = line;
+  const char *end = line + len;
+  char dir[FS_PATH_MAX];
+  uint8_t field = 0;
+  size_t n = 0;
+  uint8_t i = 0;
+
+  for (field = 0; field < 4; field++)
+  {
+    while ((p < end) && (*p != ' '))
+    {
+      p++;
+    }
+    p++;
+  }
+
+  while ((p < end) && (*p != ' '))
+  {
+    if (n == FS_PATH_MAX - 1)
+    {
+      return;
+    }
+    if ((*p == '\\') && (p + 3 < end))
+    {
+      dir[n++] = ((p[1] - '0') << 6) | ((p[2] - '0') << 3) | (p[3] - '0');
+      p += 4;
+    }
+    else
+    {
+      dir[n++] = *p++;
+    }
+  }
+  dir[n] = '\0';
+
+  for (i = 0; i < fsMountCount; i++)
+  {
+    if (strcmp(dir, fsMounts[i].mountPoint) == 0)
+    {
+      fsMounts[i].mounted = 1;
+    }
+  }
+}
+
+/**
+ * @brief Re-read /proc/self/mountinfo and record which mount points are mounted.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static uint8_t FSInfoReadTable(void)
+{
+  uint8_t i = 0;
+
+  for (i = 0; i < fsMountCount; i++)
+  {
+    fsMounts[i].mounted = 0;
+  }
+
+  if (ProcFileForEachLine(&procMountinfo, FSInfoParseLine, NULL) < 0)
+  {
+    return 1;
+  }
+
+  // the root filesystem is always there, even when chrooted
+  fsMounts[0].mounted = 1;
+  return 0;
+}
+
+/**
+ * @brief Refresh the mount table if it changed, then statvfs() every mounted entry.
+ *
+ * @return Number of tracked entries (at least 1, the root filesystem).
+ */
+uint8_t FSInfoUpdate(void)
+{
+  struct pollfd pfd;
+  struct statvfs vfs;
+  uint64_t used = 0;
+  uint64_t avail = 0;
+  uint8_t i = 0;
+
+  if (fsMountCount == 0)
+  {
+    FSInfoConfigure();
+  }
+
+  if (procMountinfo.fd >= 0)
+  {
+    pfd.fd = procMountinfo.fd;
+    pfd.events = POLLPRI;
+    pfd.revents = 0;
+    // polling also acknowledges the change, so the next call sees a quiet table
+    if ((poll(&pfd, 1, 0) > 0) && (pfd.revents & (POLLPRI | POLLERR)))
+    {
+      fsTableValid = 0;
+    }
+  }
+  if (!fsTableValid)
+  {
+    fsTableValid = (FSInfoReadTable() == 0);
+    if (!fsTableValid)
+    {
+      // without a mount table only the root filesystem can be trusted
+      fsMounts[0].mounted = 1;
+    }
+  }
+
+  for (i = 0; i < fsMountCount; i++)
+  {
+    if (!fsMounts[i].mounted)
+    {
+      continue;
+    }
+    if (statvfs(fsMounts[i].mountPoint, &vfs) != 0)
+    {
+      fprintf(stderr, "rpiInfo: Unable to stat %s filesystem.\n", fsMounts[i].mountPoint);
+      fsMounts[i].mounted = 0;
+      continue;
+    }
+
+    // df(1): used = blocks - free, percentage is used / (used + available) rounded up
+    used = vfs.f_blocks - vfs.f_bfree;
+    avail = vfs.f_bavail;
+    fsMounts[i].totalKB = (uint64_t)vfs.f_blocks * vfs.f_frsize / 1024;
+    fsMounts[i].usedKB = used * vfs.f_frsize / 1024;
+    fsMounts[i].availKB = avail * vfs.f_frsize / 1024;
+    fsMounts[i].usedPct = (used + avail > 0) ? (used * 100 + used + avail - 1) / (used + avail) : 0;
+  }
+
+  return fsMountCount;
+}
+
+/**
+ * @brief Get a tracked filesystem as of the last FSInfoUpdate().
+ *
+ * @param index 0 for the root filesystem, then FS_MOUNT_POINTS in order.
+ * @return Usage entry, or NULL past the end.
+ */
+const FSUsage *FSInfoGet(uint8_t index)
+{
+  return (index < fsMountCount) ? &fsMounts[index] : NULL;
+}
+
+/**
+ * @brief File descriptor that polls POLLPRI when the mount table changes.
+ *
+ * Waiting on it with epoll acknowledges the change just like poll() does, so
+ * the waiter must call FSInfoChanged() before the next FSInfoUpdate().
+ *
+ * @return /proc/self/mountinfo descriptor, or -1 before the first update.
+ */
+int FSInfoFd(void)
+{
+  return procMountinfo.fd;
+}
+
+/**
+ * @brief Re-read the mount table on the next FSInfoUpdate().
+ *
+ * @return void
+ */
+void FSInfoChanged(void)
+{
+  fsTableValid = 0;
+}
+
+/**
+ * @brief Get root filesystem usage the way df reports it.
+ *
+ * @return Used amount of FS storage in percent.
+ */
+uint8_t GetFSMemory(void)
+{
+  FSInfoUpdate();
+
+  /*
+  fprintf(stderr, "(statvfs) Disk Free: %llu kB, Disk Used: %llu kB (%u %%), Total: %llu kB\n", fsMounts[0].availKB, fsMounts[0].usedKB, fsMounts[0].usedPct, fsMounts[0].totalKB);
+  */
+
+  return fsMounts[0].mounted ? fsMounts[0].usedPct : 0;
+}
@@ -0,0 +1,27 @@
+#ifndef __FSINFO_H
+#define __FSINFO_H
+
+#include <stdint.h>
+
+// Filesystems tracked: the root filesystem plus FS_MOUNT_POINTS
+#define FS_MOUNT_MAX 8
+#define FS_PATH_MAX 64
+
+// Usage of one tracked mount point, in df(1) terms
+typedef struct FSUsage
+{
+  char mountPoint[FS_PATH_MAX];
+  uint8_t mounted;
+  uint64_t totalKB;
+  uint64_t usedKB;
+  uint64_t availKB;
+  uint8_t usedPct;
+} FSUsage;
+
+uint8_t FSInfoUpdate(void);
+const FSUsage *FSInfoGet(uint8_t index);
+int FSInfoFd(void);
+void FSInfoChanged(void);
+uint8_t GetFSMemory(void);
+
+#endif /*__FSINFO_H*/
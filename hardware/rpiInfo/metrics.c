@@ -0,0 +1,86 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "metrics.h"
+#include "nospawn.h"
+
+/*
+ * The published metrics snapshot, a seqlock.
+ *
+ * Collectors publish under a mutex that only writers take. Readers never
+ * lock or block: they copy the snapshot and retry if the sequence number was
+ * odd (a write in progress) or changed while they copied. The payload is held
+ * as relaxed atomic words so that a torn copy, which is detected and
+ * discarded, is still not a data race. Fences follow Boehm, "Can seqlocks get
+ * along with programming language memory models?" (MSPC 2012).
+ */
+
+#define METRICS_WORDS ((sizeof(Metrics) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+static _Atomic uint32_t metricsSeq = 0;
+static _Atomic uint64_t metricsWords[METRICS_WORDS];
+static pthread_mutex_t metricsWriteLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Publish a new snapshot.
+ *
+ * @param m Snapshot to copy in.
+ * @return void
+ */
+void MetricsPublish(const Metrics *m)
+{
+  uint64_t words[METRICS_WORDS] = {0};
+  uint32_t seq = 0;
+  size_t i = 0;
+
+  memcpy(words, m, sizeof(*m));
+
+  pthread_mutex_lock(&metricsWriteLock);
+  seq = atomic_load_explicit(&metricsSeq, memory_order_relaxed);
+  atomic_store_explicit(&metricsSeq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  for (i = 0; i < METRICS_WORDS; i++)
+  {
+    atomic_store_explicit(&metricsWords[i], words[i], memory_order_relaxed);
+  }
+  atomic_store_explicit(&metricsSeq, seq + 2, memory_order_release);
+  pthread_mutex_unlock(&metricsWriteLock);
+}
+
+/**
+ * @brief Copy the latest snapshot without locking.
+ *
+ * @param m Destination.
+ * @return Number of snapshots published so far; 0 means m is all zeroes.
+ */
+uint32_t MetricsRead(Metrics *m)
+{
+  uint64_t words[METRICS_WORDS];
+  uint32_t before = 0;
+  uint32_t after = 0;
+  size_t i = 0;
+
+  for (;;)
+  {
+    before = atomic_load_explicit(&metricsSeq, memory_order_acquire);
+    if (!(before & 1))
+    {
+      for (i = 0; i < METRICS_WORDS; i++)
+      {
+        words[i] = atomic_load_explicit(&metricsWords[i], memory_order_relaxed);
+      }
+      atomic_thread_fence(memory_order_acquire);
+      after = atomic_load_explicit(&metricsSeq, memory_order_relaxed);
+      if (before == after)
+      {
+        break;
+      }
+    }
+    // the writer may be preempted mid-update on a single core; let it finish
+    sched_yield();
+  }
+
+  memcpy(m, words, sizeof(*m));
+  return before / 2;
+}
@@ -0,0 +1,31 @@
+#ifndef __METRICS_H
+#define __METRICS_H
+
+#include <limits.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include "diskstats.h"
+#include "fsinfo.h"
+#include "netdev.h"
+
+// Everything the pages show, collected off the render path and published as one snapshot
+typedef struct Metrics
+{
+  char hostname[HOST_NAME_MAX + 1];
+  uint8_t cpuUsage;
+  uint8_t memoryPct;
+  uint8_t temperature;
+  FSUsage fs[FS_MOUNT_MAX];
+  uint8_t fsCount;
+  char ifname[IF_NAMESIZE];
+  char ipAddress[INET_ADDRSTRLEN];
+  NetDevStats net;
+  int32_t linkSpeed;
+  DiskStats disk;
+  uint8_t diskPresent;
+} Metrics;
+
+void MetricsPublish(const Metrics *m);
+uint32_t MetricsRead(Metrics *m);
+
+#endif /*__METRICS_H*/
@@ -0,0 +1,278 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "netdev.h"
+#include "procfile.h"
+#include "nospawn.h"
+
+/*
+ * Per-interface traffic from /proc/net/dev.
+ *
+ * Each tracked interface keeps the raw text of its last line. Idle interfaces
+ * (most of them, on a rack node) produce byte-identical lines, which are
+ * recognised with one memcmp() and not parsed again; their rates drop to zero.
+ * Rates are computed against CLOCK_MONOTONIC timestamps, so they are per real
+ * second regardless of sampling jitter.
+ *
+ * NetDevSample() runs on the sampler thread and parses into a table only it
+ * touches; the stats are then copied into a published table, and the mutex
+ * is held only for that copy and for NetDevGet() reading from it.
+ */
+
+typedef struct NetDevEntry
+{
+  NetDevStats stats;
+  char line[NETDEV_LINE_MAX];
+  uint16_t lineLen;
+  uint8_t seen;
+} NetDevEntry;
+
+static ProcFile procNetDev = PROCFILE_INIT("/proc/net/dev");
+// Sampler side
+static NetDevEntry netDevs[NETDEV_MAX];
+static uint8_t netDevCount = 0;
+static struct timespec netDevSampled;
+static uint8_t netDevSampledValid = 0;
+// Link speed of the interface last asked for, kept open until another is
+static char netDevSpeedPath[64];
+static ProcFile netDevSpeed = PROCFILE_INIT(netDevSpeedPath);
+// What NetDevGet() reads, guarded by netDevLock
+static NetDevStats netDevPublished[NETDEV_MAX];
+static uint8_t netDevPublishedCount = 0;
+static pthread_mutex_t netDevLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Rate per second of a counter over an interval.
+ *
+ * @param cur Current counter value.
+ * @param prev Previous counter value.
+ * @param ns Interval in nanoseconds.
+ * @return Rate, 0 if the counter went backwards (interface reset).
+ */
+static uint64_t NetDevRate(uint64_t cur, uint64_t prev, uint64_t ns)
+{
+  if ((cur < prev) || (ns == 0))
+  {
+    return 0;
+  }
+  return (uint64_t)((double)(cur - prev) * 1e9 / ns);
+}
+
+/**
+ * @brief Parse the counters of one changed line into an entry.
+ *
+ * @param dev Entry to update.
+ * @param p Text after the "name:" prefix.
+ * @param ns Time since the previous sample in nanoseconds, 0 for the first.
+ * @return void
+ */
+static void NetDevParse(NetDevEntry *dev, const char *p, uint64_t ns)
+{
+  // rx: bytes packets errs drop fifo frame compressed multicast, then tx: bytes packets ...
+  uint64_t f[10] = {0};
+  uint8_t n = 0;
+
+  for (n = 0; n < 10; n++)
+  {
+    p = ParseUnsigned(p, &f[n]);
+    if (p == NULL)
+    {
+      return;
+    }
+  }
+
+  if (ns > 0)
+  {
+    dev->stats.rxBytesRate = NetDevRate(f[0], dev->stats.rxBytes, ns);
+    dev->stats.rxPacketsRate = NetDevRate(f[1], dev->stats.rxPackets, ns);
+    dev->stats.txBytesRate = NetDevRate(f[8], dev->stats.txBytes, ns);
+    dev->stats.txPacketsRate = NetDevRate(f[9], dev->stats.txPackets, ns);
+  }
+  dev->stats.rxBytes = f[0];
+  dev->stats.rxPackets = f[1];
+  dev->stats.txBytes = f[8];
+  dev->stats.txPackets = f[9];
+}
+
+/**
+ * @brief Update the entry of the interface on one line of /proc/net/dev.
+ *
+ * @param line Line, NUL-terminated.
+ * @param len Length of the line.
+ * @param ctx Time since the previous sample in nanoseconds (uint64_t *), 0 for the first.
+ * @return void
+ */
+static void NetDevParseLine(char *line, size_t len, void *ctx)
+{
+  uint64_t ns = *(uint64_t *)ctx;
+  const char *name, *colon;
+  NetDevEntry *dev;
+  uint8_t i = 0;
+
+  // the two column header lines have no colon
+  colon = memchr(line, ':', len);
+  if (colon == NULL)
+  {
+    return;
+  }
+  for (name = line; *name == ' '; name++)
+    ;
+
+  for (i = 0; i < netDevCount; i++)
+  {
+    if ((strncmp(netDevs[i].stats.name, name, colon - name) == 0) && (netDevs[i].stats.name[colon - name] == '\0'))
+    {
+      break;
+    }
+  }
+  if (i == netDevCount)
+  {
+    if ((netDevCount == NETDEV_MAX) || ((size_t)(colon - name) >= IF_NAMESIZE))
+    {
+      return;
+    }
+    memset(&netDevs[i], 0, sizeof(netDevs[i]));
+    memcpy(netDevs[i].stats.name, name, colon - name);
+    netDevCount++;
+  }
+  dev = &netDevs[i];
+  dev->seen = 1;
+
+  if ((len == dev->lineLen) && (memcmp(line, dev->line, len) == 0))
+  {
+    // no counter moved
+    dev->stats.rxBytesRate = 0;
+    dev->stats.rxPacketsRate = 0;
+    dev->stats.txBytesRate = 0;
+    dev->stats.txPacketsRate = 0;
+    return;
+  }
+
+  // a new interface has no previous counters to rate against
+  NetDevParse(dev, colon + 1, (dev->lineLen > 0) ? ns : 0);
+  if (len < NETDEV_LINE_MAX)
+  {
+    memcpy(dev->line, line, len);
+    dev->lineLen = len;
+  }
+  else
+  {
+    dev->lineLen = 0;
+  }
+}
+
+/**
+ * @brief Read /proc/net/dev and update counters and rates.
+ *
+ * The file is walked line by line, so any number of interfaces fits in the
+ * ProcFile buffer.
+ *
+ * @return Number of interfaces tracked, 0 on failure.
+ */
+uint8_t NetDevSample(void)
+{
+  struct timespec now;
+  uint64_t ns = 0;
+  uint8_t i = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  if (netDevSampledValid)
+  {
+    ns = (now.tv_sec - netDevSampled.tv_sec) * 1000000000ULL + now.tv_nsec - netDevSampled.tv_nsec;
+  }
+
+  for (i = 0; i < netDevCount; i++)
+  {
+    netDevs[i].seen = 0;
+  }
+
+  if (ProcFileForEachLine(&procNetDev, NetDevParseLine, &ns) < 0)
+  {
+    return 0;
+  }
+
+  // drop interfaces that have gone away
+  for (i = 0; i < netDevCount;)
+  {
+    if (netDevs[i].seen)
+    {
+      i++;
+    }
+    else
+    {
+      netDevs[i] = netDevs[--netDevCount];
+    }
+  }
+
+  netDevSampled = now;
+  netDevSampledValid = 1;
+
+  pthread_mutex_lock(&netDevLock);
+  for (i = 0; i < netDevCount; i++)
+  {
+    netDevPublished[i] = netDevs[i].stats;
+  }
+  netDevPublishedCount = netDevCount;
+  pthread_mutex_unlock(&netDevLock);
+  return netDevCount;
+}
+
+/**
+ * @brief Copy the counters and rates of one interface.
+ *
+ * @param name Interface name.
+ * @param stats Destination.
+ * @return 0 on success, 1 if the interface is not tracked.
+ */
+uint8_t NetDevGet(const char *name, NetDevStats *stats)
+{
+  uint8_t i = 0;
+  uint8_t ret = 1;
+
+  pthread_mutex_lock(&netDevLock);
+  for (i = 0; i < netDevPublishedCount; i++)
+  {
+    if (strcmp(netDevPublished[i].name, name) == 0)
+    {
+      *stats = netDevPublished[i];
+      ret = 0;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&netDevLock);
+  return ret;
+}
+
+/**
+ * @brief Read the negotiated link speed of an interface.
+ *
+ * The sysfs file stays open while the same interface is asked for, which is
+ * every sample until the default route moves. Call from the sampler thread.
+ *
+ * @param name Interface name.
+ * @return Speed in Mbit/s, or -1 if unknown (link down, wireless, virtual).
+ */
+int32_t NetDevLinkSpeed(const char *name)
+{
+  char path[sizeof(netDevSpeedPath)];
+
+  if (*name == '\0')
+  {
+    return -1;
+  }
+  snprintf(path, sizeof(path), "/sys/class/net/%s/speed", name);
+  if (strcmp(path, netDevSpeedPath) != 0)
+  {
+    ProcFileClose(&netDevSpeed);
+    strcpy(netDevSpeedPath, path);
+  }
+  // reading fails with EINVAL when the driver does not know the speed
+  if (ProcFileRead(&netDevSpeed) <= 0)
+  {
+    return -1;
+  }
+  return atoi(netDevSpeed.buf);
+}
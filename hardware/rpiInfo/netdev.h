@@ -0,0 +1,31 @@
+#ifndef __NETDEV_H
+#define __NETDEV_H
+
+#include <net/if.h>
+#include <stdint.h>
+
+// Interfaces tracked from /proc/net/dev; further ones are ignored
+#define NETDEV_MAX 16
+// Longest /proc/net/dev line kept for change detection
+#define NETDEV_LINE_MAX 256
+
+// Counters and rates of one interface
+typedef struct NetDevStats
+{
+  char name[IF_NAMESIZE];
+  uint64_t rxBytes;
+  uint64_t rxPackets;
+  uint64_t txBytes;
+  uint64_t txPackets;
+  // per second, over the last sampling interval
+  uint64_t rxBytesRate;
+  uint64_t rxPacketsRate;
+  uint64_t txBytesRate;
+  uint64_t txPacketsRate;
+} NetDevStats;
+
+uint8_t NetDevSample(void);
+uint8_t NetDevGet(const char *name, NetDevStats *stats);
+int32_t NetDevLinkSpeed(const char *name);
+
+#endif /*__NETDEV_H*/
@@ -0,0 +1,504 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "netinfo.h"
+#include "nospawn.h"
+
+/*
+ * Default interface and address, kept current from rtnetlink.
+ *
+ * One NETLINK_ROUTE socket subscribes to IPv4 route and address changes, and
+ * to link changes. At startup the address and route tables are dumped into
+ * two small tables; afterwards the multicast notifications are applied to
+ * them as they arrive. IPv4 routes that go away with their address or link
+ * are not always announced, so deleting an address, a link being removed or
+ * taken down, renaming the default interface (or losing notifications to a
+ * full socket buffer) triggers a fresh dump instead.
+ *
+ * The default interface is the one on the main-table default route with the
+ * lowest metric, falling back to eth0 like the /proc/net/route parser did.
+ */
+
+typedef struct NetRoute
+{
+  int ifindex;
+  uint32_t priority;
+} NetRoute;
+
+typedef struct NetAddr
+{
+  int ifindex;
+  struct in_addr addr;
+} NetAddr;
+
+static int netFd = -1;
+static uint32_t netSeq = 0;
+static uint8_t netResync = 1;
+
+static NetRoute netRoutes[NET_ROUTE_MAX];
+static uint8_t netRouteCount = 0;
+static NetAddr netAddrs[NET_ADDR_MAX];
+static uint8_t netAddrCount = 0;
+
+static int netIfindex = 0;
+static uint8_t netFallback = 0;
+static char netIfname[IF_NAMESIZE] = "eth0";
+static char netAddrStr[INET_ADDRSTRLEN] = "0.0.0.0";
+
+/**
+ * @brief Apply an RTM_NEWROUTE/RTM_DELROUTE message to the default route table.
+ *
+ * @param nh Netlink message.
+ * @return void
+ */
+static void NetInfoRoute(const struct nlmsghdr *nh)
+{
+  const struct rtmsg *rt = NLMSG_DATA(nh);
+  const struct rtattr *rta;
+  const struct rtnexthop *nhop;
+  int len = RTM_PAYLOAD(nh);
+  uint32_t table = rt->rtm_table;
+  NetRoute route = {0, 0};
+  uint8_t replace = 0;
+  uint8_t i = 0;
+
+  if ((rt->rtm_family != AF_INET) || (rt->rtm_dst_len != 0) || (rt->rtm_type != RTN_UNICAST))
+  {
+    return;
+  }
+
+  for (rta = RTM_RTA(rt); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+  {
+    switch (rta->rta_type)
+    {
+    case RTA_TABLE:
+      table = *(const uint32_t *)RTA_DATA(rta);
+      break;
+    case RTA_OIF:
+      route.ifindex = *(const int *)RTA_DATA(rta);
+      break;
+    case RTA_PRIORITY:
+      route.priority = *(const uint32_t *)RTA_DATA(rta);
+      break;
+    case RTA_MULTIPATH:
+      // use the first hop of a multipath default route
+      nhop = RTA_DATA(rta);
+      if ((route.ifindex == 0) && (RTA_PAYLOAD(rta) >= sizeof(*nhop)))
+      {
+        route.ifindex = nhop->rtnh_ifindex;
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  if ((table != RT_TABLE_MAIN) || (route.ifindex == 0))
+  {
+    return;
+  }
+
+  // "ip route replace" announces only the new route, which takes over the old one's metric
+  replace = (nh->nlmsg_type == RTM_NEWROUTE) && (nh->nlmsg_flags & NLM_F_REPLACE);
+  for (i = 0; i < netRouteCount; i++)
+  {
+    if ((netRoutes[i].priority == route.priority) && (replace || (netRoutes[i].ifindex == route.ifindex)))
+    {
+      break;
+    }
+  }
+
+  if (nh->nlmsg_type == RTM_DELROUTE)
+  {
+    if (i < netRouteCount)
+    {
+      netRoutes[i] = netRoutes[--netRouteCount];
+    }
+  }
+  else if (i < netRouteCount)
+  {
+    netRoutes[i] = route;
+  }
+  else if (netRouteCount < NET_ROUTE_MAX)
+  {
+    netRoutes[netRouteCount++] = route;
+  }
+}
+
+/**
+ * @brief Apply an RTM_NEWADDR/RTM_DELADDR message to the address table.
+ *
+ * Only the primary IPv4 address of each interface is kept, which is what
+ * SIOCGIFADDR used to report.
+ *
+ * @param nh Netlink message.
+ * @return void
+ */
+static void NetInfoAddr(const struct nlmsghdr *nh)
+{
+  const struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+  const struct rtattr *rta;
+  int len = IFA_PAYLOAD(nh);
+  NetAddr addr = {(int)ifa->ifa_index, {0}};
+  uint8_t haveLocal = 0;
+  uint8_t haveAddr = 0;
+  uint8_t i = 0;
+
+  if ((ifa->ifa_family != AF_INET) || (ifa->ifa_flags & IFA_F_SECONDARY))
+  {
+    return;
+  }
+
+  for (rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+  {
+    // IFA_LOCAL is the interface's own address; IFA_ADDRESS is the peer on point-to-point links
+    if ((rta->rta_type == IFA_LOCAL) && (RTA_PAYLOAD(rta) >= sizeof(addr.addr)))
+    {
+      memcpy(&addr.addr, RTA_DATA(rta), sizeof(addr.addr));
+      haveLocal = 1;
+    }
+    else if ((rta->rta_type == IFA_ADDRESS) && !haveLocal && (RTA_PAYLOAD(rta) >= sizeof(addr.addr)))
+    {
+      memcpy(&addr.addr, RTA_DATA(rta), sizeof(addr.addr));
+      haveAddr = 1;
+    }
+  }
+  if (!haveLocal && !haveAddr)
+  {
+    return;
+  }
+
+  for (i = 0; i < netAddrCount; i++)
+  {
+    if (netAddrs[i].ifindex == addr.ifindex)
+    {
+      break;
+    }
+  }
+
+  if (nh->nlmsg_type == RTM_DELADDR)
+  {
+    if ((i < netAddrCount) && (netAddrs[i].addr.s_addr == addr.addr.s_addr))
+    {
+      netAddrs[i] = netAddrs[--netAddrCount];
+    }
+    // routes through this address may have vanished without notification
+    netResync = 1;
+  }
+  else if ((i == netAddrCount) && (netAddrCount < NET_ADDR_MAX))
+  {
+    // the first primary address wins, as with SIOCGIFADDR
+    netAddrs[netAddrCount++] = addr;
+  }
+}
+
+/**
+ * @brief Resync on an RTM_NEWLINK/RTM_DELLINK message that can affect the default route.
+ *
+ * Other link notifications (carrier, statistics, wireless events) are ignored,
+ * they arrive often and leave routes alone.
+ *
+ * @param nh Netlink message.
+ * @return void
+ */
+static void NetInfoLink(const struct nlmsghdr *nh)
+{
+  const struct ifinfomsg *ifi = NLMSG_DATA(nh);
+  const struct rtattr *rta;
+  int len = IFLA_PAYLOAD(nh);
+
+  // a link going down or away takes its routes with it, often without RTM_DELROUTE
+  if ((nh->nlmsg_type == RTM_DELLINK) || (ifi->ifi_change & IFF_UP))
+  {
+    netResync = 1;
+  }
+  if ((ifi->ifi_index != netIfindex) || netFallback)
+  {
+    return;
+  }
+
+  for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len))
+  {
+    if ((rta->rta_type == IFLA_IFNAME) && (strncmp(RTA_DATA(rta), netIfname, sizeof(netIfname)) != 0))
+    {
+      // renamed: forget the selection so NetInfoSelect() looks the name up again
+      netIfindex = 0;
+      netResync = 1;
+    }
+  }
+}
+
+/**
+ * @brief Receive and apply pending netlink messages.
+ *
+ * @param seq Dump sequence number to wait for, or 0 to only drain what is queued.
+ * @return 0 when drained (or the dump completed), 1 on failure.
+ */
+static uint8_t NetInfoReceive(uint32_t seq)
+{
+  char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+  struct pollfd pfd = {netFd, POLLIN, 0};
+  const struct nlmsghdr *nh;
+  ssize_t len = 0;
+
+  for (;;)
+  {
+    len = recv(netFd, buf, sizeof(buf), 0);
+    if (len < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+      {
+        if (seq == 0)
+        {
+          return 0;
+        }
+        if (poll(&pfd, 1, 1000) <= 0)
+        {
+          fprintf(stderr, "rpiInfo: Timed out waiting for netlink dump.\n");
+          return 1;
+        }
+        continue;
+      }
+      if (errno == ENOBUFS)
+      {
+        // notifications were dropped, the tables can no longer be trusted
+        netResync = 1;
+        continue;
+      }
+      fprintf(stderr, "rpiInfo: Unable to read netlink socket.\n");
+      return 1;
+    }
+
+    for (nh = (const struct nlmsghdr *)buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len))
+    {
+      switch (nh->nlmsg_type)
+      {
+      case RTM_NEWROUTE:
+      case RTM_DELROUTE:
+        NetInfoRoute(nh);
+        break;
+      case RTM_NEWADDR:
+      case RTM_DELADDR:
+        NetInfoAddr(nh);
+        break;
+      case RTM_NEWLINK:
+      case RTM_DELLINK:
+        NetInfoLink(nh);
+        break;
+      case NLMSG_DONE:
+        if ((seq != 0) && (nh->nlmsg_seq == seq))
+        {
+          return 0;
+        }
+        break;
+      case NLMSG_ERROR:
+        if ((seq != 0) && (nh->nlmsg_seq == seq))
+        {
+          fprintf(stderr, "rpiInfo: Netlink dump request failed.\n");
+          return 1;
+        }
+        break;
+      default:
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Request a full dump of one rtnetlink table and apply it.
+ *
+ * @param type RTM_GETADDR or RTM_GETROUTE.
+ * @return 0 on success, 1 on failure.
+ */
+static uint8_t NetInfoDump(uint16_t type)
+{
+  struct
+  {
+    struct nlmsghdr nh;
+    struct rtgenmsg gen;
+  } req;
+
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.gen));
+  req.nh.nlmsg_type = type;
+  req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.nh.nlmsg_seq = ++netSeq;
+  req.gen.rtgen_family = AF_INET;
+
+  if (send(netFd, &req, req.nh.nlmsg_len, 0) < 0)
+  {
+    fprintf(stderr, "rpiInfo: Unable to send netlink dump request.\n");
+    return 1;
+  }
+  return NetInfoReceive(netSeq);
+}
+
+/**
+ * @brief Open the rtnetlink socket, subscribed to IPv4 route, address and link changes.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+static uint8_t NetInfoOpen(void)
+{
+  struct sockaddr_nl sa;
+
+  netFd = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (netFd < 0)
+  {
+    fprintf(stderr, "rpiInfo: Unable to open netlink socket.\n");
+    return 1;
+  }
+
+  memset(&sa, 0, sizeof(sa));
+  sa.nl_family = AF_NETLINK;
+  sa.nl_groups = RTMGRP_IPV4_ROUTE | RTMGRP_IPV4_IFADDR | RTMGRP_LINK;
+  if (bind(netFd, (struct sockaddr *)&sa, sizeof(sa)) < 0)
+  {
+    fprintf(stderr, "rpiInfo: Unable to bind netlink socket.\n");
+    close(netFd);
+    netFd = -1;
+    return 1;
+  }
+
+  netResync = 1;
+  return 0;
+}
+
+/**
+ * @brief Derive the default interface and its address from the tables.
+ *
+ * @return 1 if either changed, 0 otherwise.
+ */
+static uint8_t NetInfoSelect(void)
+{
+  char addrStr[INET_ADDRSTRLEN] = "0.0.0.0";
+  uint8_t changed = 0;
+  int ifindex = 0;
+  uint32_t priority = UINT32_MAX;
+  uint8_t i = 0;
+
+  for (i = 0; i < netRouteCount; i++)
+  {
+    if ((ifindex == 0) || (netRoutes[i].priority < priority))
+    {
+      ifindex = netRoutes[i].ifindex;
+      priority = netRoutes[i].priority;
+    }
+  }
+
+  // names are only looked up when the selection changes
+  if (ifindex == 0)
+  {
+    if (!netFallback)
+    {
+      fprintf(stderr, "rpiInfo: Unable to determine default interface. Defaulting to eth0.\n");
+      netFallback = 1;
+      netIfindex = if_nametoindex("eth0");
+      strcpy(netIfname, "eth0");
+      changed = 1;
+    }
+  }
+  else if ((ifindex != netIfindex) || netFallback)
+  {
+    netFallback = 0;
+    netIfindex = ifindex;
+    if (if_indextoname(ifindex, netIfname) == NULL)
+    {
+      snprintf(netIfname, sizeof(netIfname), "if%d", ifindex);
+    }
+    changed = 1;
+  }
+
+  for (i = 0; i < netAddrCount; i++)
+  {
+    if (netAddrs[i].ifindex == netIfindex)
+    {
+      inet_ntop(AF_INET, &netAddrs[i].addr, addrStr, sizeof(addrStr));
+      break;
+    }
+  }
+
+  if (strcmp(addrStr, netAddrStr) != 0)
+  {
+    strcpy(netAddrStr, addrStr);
+    changed = 1;
+  }
+  return changed;
+}
+
+/**
+ * @brief Apply pending rtnetlink notifications without blocking.
+ *
+ * Opens the socket and dumps the tables on first use. Afterwards this only
+ * drains what the kernel has queued, so it is cheap enough to call per frame;
+ * an event loop can instead call it when NetInfoFd() becomes readable.
+ *
+ * @return 1 if the default interface or its address changed, 0 otherwise.
+ */
+uint8_t NetInfoUpdate(void)
+{
+  if ((netFd < 0) && NetInfoOpen())
+  {
+    return 0;
+  }
+
+  NetInfoReceive(0);
+
+  while (netResync)
+  {
+    netResync = 0;
+    netRouteCount = 0;
+    netAddrCount = 0;
+    // the kernel serves one dump at a time per socket
+    if (NetInfoDump(RTM_GETADDR) || NetInfoDump(RTM_GETROUTE))
+    {
+      netResync = 1;
+      break;
+    }
+  }
+
+  return NetInfoSelect();
+}
+
+/**
+ * @brief File descriptor that becomes readable when routes, addresses or links change.
+ *
+ * @return rtnetlink socket, or -1 before the first update.
+ */
+int NetInfoFd(void)
+{
+  return netFd;
+}
+
+/**
+ * @brief Name of the default interface as of the last NetInfoUpdate().
+ *
+ * @return Interface name, "eth0" when there is no default route.
+ */
+const char *NetInfoInterface(void)
+{
+  return netIfname;
+}
+
+/**
+ * @brief IPv4 address of the default interface as of the last NetInfoUpdate().
+ *
+ * @return Address in dotted-quad notation, "0.0.0.0" when it has none.
+ */
+const char *NetInfoAddress(void)
+{
+  return netAddrStr;
+}
@@ -0,0 +1,15 @@
+#ifndef __NETINFO_H
+#define __NETINFO_H
+
+#include <stdint.h>
+
+// Default IPv4 routes and interface addresses tracked from rtnetlink
+#define NET_ROUTE_MAX 8
+#define NET_ADDR_MAX 16
+
+uint8_t NetInfoUpdate(void);
+int NetInfoFd(void);
+const char *NetInfoInterface(void);
+const char *NetInfoAddress(void);
+
+#endif /*__NETINFO_H*/
@@ -0,0 +1,12 @@
+#ifndef __NOSPAWN_H
+#define __NOSPAWN_H
+
+/*
+ * Metric collectors must never create processes: a shell pipeline per sample
+ * costs more than everything else the daemon does. Any use of these in a file
+ * that includes this header is a compile error. Include it last, after every
+ * system header, since those legitimately declare the poisoned names.
+ */
+#pragma GCC poison popen pclose system fork vfork clone execl execle execlp execv execve execvp execvpe fexecve posix_spawn posix_spawnp
+
+#endif /*__NOSPAWN_H*/
@@ -0,0 +1,270 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "procfile.h"
+#include "nospawn.h"
+
+/**
+ * @brief Open a pseudofile unless it is already open.
+ *
+ * @param pf Pseudofile to open.
+ * @return 0 on success, -1 on failure.
+ */
+static int ProcFileOpen(ProcFile *pf)
+{
+  if (pf->fd < 0)
+  {
+    pf->fd = open(pf->path, O_RDONLY | O_CLOEXEC);
+    if (pf->fd < 0)
+    {
+      fprintf(stderr, "rpiInfo: Unable to open %s pseudofile.\n", pf->path);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Re-read a pseudofile from offset 0 into its buffer.
+ *
+ * The file is opened on first use and kept open; procfs and sysfs regenerate
+ * the contents on every read at offset 0, so no reopen or stdio is needed.
+ * If the read fails (e.g. the sysfs node went away) the file is reopened once.
+ * A sysfs attribute the driver cannot report right now fails with EINVAL;
+ * that is returned as is, with the file left open for the next read.
+ *
+ * @param pf Pseudofile to read.
+ * @return Number of bytes read (buf is NUL-terminated), or -1 on failure.
+ */
+int ProcFileRead(ProcFile *pf)
+{
+  ssize_t len = -1;
+  uint8_t attempt = 0;
+
+  for (attempt = 0; attempt < 2; attempt++)
+  {
+    if (ProcFileOpen(pf) < 0)
+    {
+      return -1;
+    }
+
+    do
+    {
+      len = pread(pf->fd, pf->buf, sizeof(pf->buf) - 1, 0);
+    } while ((len < 0) && (errno == EINTR));
+
+    if (len >= 0)
+    {
+      pf->buf[len] = '\0';
+      return len;
+    }
+    if (errno == EINVAL)
+    {
+      return -1;
+    }
+
+    ProcFileClose(pf);
+  }
+
+  fprintf(stderr, "rpiInfo: Unable to read %s pseudofile.\n", pf->path);
+  return -1;
+}
+
+/**
+ * @brief Read a pseudofile of any length from offset 0, one line at a time.
+ *
+ * The buffer is used as a sliding window, so files larger than
+ * PROCFILE_BUF_SIZE (mountinfo, diskstats with many devices) are read whole.
+ * Each line is passed NUL-terminated and without its newline; lines longer
+ * than the buffer are skipped.
+ *
+ * @param pf Pseudofile to read.
+ * @param fn Called for every line.
+ * @param ctx Passed through to fn.
+ * @return 0 on success, -1 on failure.
+ */
+int ProcFileForEachLine(ProcFile *pf, void (*fn)(char *line, size_t len, void *ctx), void *ctx)
+{
+  size_t used = 0;
+  off_t offset = 0;
+  ssize_t len = 0;
+  uint8_t skipping = 0;
+  char *line, *nl;
+
+  if (ProcFileOpen(pf) < 0)
+  {
+    return -1;
+  }
+
+  for (;;)
+  {
+    len = pread(pf->fd, pf->buf + used, sizeof(pf->buf) - 1 - used, offset);
+    if ((len < 0) && (errno == EINTR))
+    {
+      continue;
+    }
+    if (len < 0)
+    {
+      fprintf(stderr, "rpiInfo: Unable to read %s pseudofile.\n", pf->path);
+      ProcFileClose(pf);
+      return -1;
+    }
+    if (len == 0)
+    {
+      break;
+    }
+    offset += len;
+    used += len;
+
+    line = pf->buf;
+    while ((nl = memchr(line, '\n', pf->buf + used - line)) != NULL)
+    {
+      *nl = '\0';
+      if (!skipping)
+      {
+        fn(line, nl - line, ctx);
+      }
+      skipping = 0;
+      line = nl + 1;
+    }
+    used = pf->buf + used - line;
+    if (used == sizeof(pf->buf) - 1)
+    {
+      // no newline in a full buffer, drop the rest of this line
+      used = 0;
+      skipping = 1;
+    }
+    memmove(pf->buf, line, used);
+  }
+
+  if ((used > 0) && !skipping)
+  {
+    pf->buf[used] = '\0';
+    fn(pf->buf, used, ctx);
+  }
+  return 0;
+}
+
+/**
+ * @brief Close a pseudofile; the next ProcFileRead() reopens it.
+ *
+ * @param pf Pseudofile to close.
+ * @return void
+ */
+void ProcFileClose(ProcFile *pf)
+{
+  if (pf->fd >= 0)
+  {
+    close(pf->fd);
+    pf->fd = -1;
+  }
+}
+
+/**
+ * @brief Parse an unsigned decimal number, skipping leading blanks.
+ *
+ * @param p Text to parse.
+ * @param value Destination for the number.
+ * @return Pointer past the number, or NULL if there is no digit.
+ */
+const char *ParseUnsigned(const char *p, uint64_t *value)
+{
+  uint64_t v = 0;
+
+  while ((*p == ' ') || (*p == '\t'))
+  {
+    p++;
+  }
+  if ((*p < '0') || (*p > '9'))
+  {
+    return NULL;
+  }
+  while ((*p >= '0') && (*p <= '9'))
+  {
+    v = v * 10 + (*p++ - '0');
+  }
+  *value = v;
+  return p;
+}
+
+/**
+ * @brief Parse the aggregate "cpu" line at the start of /proc/stat.
+ *
+ * @param buf Contents of /proc/stat.
+ * @param fields Destination for the jiffy counters (user, nice, system, idle, ...).
+ * @param count Number of counters wanted.
+ * @return Number of counters parsed.
+ */
+int ParseCPUStat(const char *buf, uint64_t *fields, int count)
+{
+  const char *p = buf;
+  int n = 0;
+
+  if (strncmp(p, "cpu ", 4) != 0)
+  {
+    return 0;
+  }
+  p += 4;
+
+  for (n = 0; n < count; n++)
+  {
+    p = ParseUnsigned(p, &fields[n]);
+    if (p == NULL)
+    {
+      break;
+    }
+  }
+  return n;
+}
+
+/**
+ * @brief Pick values out of /proc/meminfo in a single pass.
+ *
+ * Stops as soon as every requested key has been found.
+ *
+ * @param buf Contents of /proc/meminfo.
+ * @param keys Field names without the colon, e.g. "MemTotal".
+ * @param values Destination for the values (kB), in key order.
+ * @param count Number of keys (at most 32).
+ * @return Number of keys found.
+ */
+int ParseMeminfo(const char *buf, const char *const *keys, uint64_t *values, int count)
+{
+  const char *p = buf;
+  const char *colon;
+  uint32_t missing = (count >= 32) ? 0xFFFFFFFF : ((1u << count) - 1);
+  int found = 0;
+  int i = 0;
+
+  while ((*p != '\0') && (missing != 0))
+  {
+    colon = strchr(p, ':');
+    if (colon == NULL)
+    {
+      break;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+      if ((missing & (1u << i)) && (strncmp(p, keys[i], colon - p) == 0) && (keys[i][colon - p] == '\0'))
+      {
+        if (ParseUnsigned(colon + 1, &values[i]) != NULL)
+        {
+          missing &= ~(1u << i);
+          found++;
+        }
+        break;
+      }
+    }
+
+    p = strchr(colon, '\n');
+    if (p == NULL)
+    {
+      break;
+    }
+    p++;
+  }
+  return found;
+}
@@ -0,0 +1,27 @@
+#ifndef __PROCFILE_H
+#define __PROCFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bytes kept per pseudofile; longer contents are truncated
+#define PROCFILE_BUF_SIZE 4096
+
+// A /proc or /sys file opened once and re-read in place with pread()
+typedef struct ProcFile
+{
+  const char *path;
+  int fd;
+  char buf[PROCFILE_BUF_SIZE];
+} ProcFile;
+
+#define PROCFILE_INIT(p) {(p), -1, {0}}
+
+int ProcFileRead(ProcFile *pf);
+int ProcFileForEachLine(ProcFile *pf, void (*fn)(char *line, size_t len, void *ctx), void *ctx);
+void ProcFileClose(ProcFile *pf);
+const char *ParseUnsigned(const char *p, uint64_t *value);
+int ParseCPUStat(const char *buf, uint64_t *fields, int count);
+int ParseMeminfo(const char *buf, const char *const *keys, uint64_t *values, int count);
+
+#endif /*__PROCFILE_H*/
@@ -1,13 +1,17 @@
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/sysinfo.h>
+#include <time.h>
 #include <sys/vfs.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <netinet/in.h>
 #include <net/if.h>
 #include <unistd.h>
@@ -15,65 +19,48 @@
 #include <sys/ioctl.h>
 #include <linux/i2c.h>
 #include <linux/i2c-dev.h>
+#include "diskstats.h"
+#include "eventloop.h"
+#include "fsinfo.h"
+#include "metrics.h"
+#include "netinfo.h"
+#include "procfile.h"
 #include "rpiInfo.h"
 #include "st7735.h"
+#include "nospawn.h"
+
+// Pseudofiles are opened once and re-read with pread()
+static ProcFile procMeminfo = PROCFILE_INIT("/proc/meminfo");
+static ProcFile procStat = PROCFILE_INIT("/proc/stat");
+static ProcFile procStatTop = PROCFILE_INIT("/proc/stat");
+static ProcFile procThermal = PROCFILE_INIT("/sys/class/thermal/thermal_zone0/temp");
+// Set while the collector thread owns sampling and the netlink socket
+static _Atomic int collectorRunning = 0;
 
 /**
  * @brief Get the IP address of the default interface.
  *
+ * The address is cached from rtnetlink notifications (see netinfo.c), so this
+ * does not touch /proc or open sockets per call.
+ *
  * @return Pointer to char of IP address in dotted-quad notation.
  */
 char *GetIPAddress(void)
 {
-  FILE *fd;
-  char line[100], *p, *c;
-
-  fd = fopen("/proc/net/route", "r");
-  if (fd == NULL)
-  {
-    fprintf(stderr, "rpiInfo: Unable to open /proc/net/route pseudofile.\n");
-    return '\0';
-  }
-
-  while (fgets(line, 100, fd))
-  {
-    p = strtok(line, " \t");
-    c = strtok(NULL, " \t");
+  static char address[INET_ADDRSTRLEN];
+  Metrics m;
 
-    if (p != NULL && c != NULL)
-    {
-      if (strcmp(c, "00000000") == 0)
-      {
-        break;
-      }
-    }
-  }
-
-  fclose(fd);
-
-  // Default to eth0 interface
-  if (p == NULL)
+  if (collectorRunning)
   {
-    fprintf(stderr, "rpiInfo: Unable to determine default interface. Defaulting to eth0.\n");
-    p = "eth0";
+    // the collector thread owns the netlink socket
+    MetricsRead(&m);
+    strcpy(address, m.ipAddress);
+    return address;
   }
 
-  int sockfd;
-  struct ifreq ifr;
-
-  sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-
-  // Type of address to retrieve - IPv4 IP address
-  ifr.ifr_addr.sa_family = AF_INET;
+  NetInfoUpdate();
 
-  // Copy the interface name in the ifreq structure
-  strncpy(ifr.ifr_name, p, IFNAMSIZ - 1);
-
-  ioctl(sockfd, SIOCGIFADDR, &ifr);
-
-  close(sockfd);
-
-  return inet_ntoa(((struct sockaddr_in *)&ifr.ifr_addr)->sin_addr);
+  return (char *)NetInfoAddress();
 }
 
 /**
@@ -83,43 +70,24 @@ char *GetIPAddress(void)
  */
 uint8_t GetMemory(void)
 {
-  struct sysinfo s_info;
-  unsigned char buffer[100] = {0};
-  unsigned char key[100] = {0};
-  unsigned int value = 0;
-  uint32_t memTotal = 0;
-  uint32_t memFree = 0;
+  static const char *const keys[] = {"MemTotal", "MemFree"};
+  uint64_t values[2] = {0};
 
-  if (sysinfo(&s_info) == 0) // Get memory information
+  if (ProcFileRead(&procMeminfo) < 0)
   {
-    FILE *fd = fopen("/proc/meminfo", "r");
-    if (fd == NULL)
-    {
-      fprintf(stderr, "rpiInfo: Unable to open /proc/meminfo file.\n");
-      return 0;
-    }
+    return 0;
+  }
 
-    while (fgets(buffer, sizeof(buffer), fd))
-    {
-      if (sscanf(buffer, "%s%u", key, &value) != 2)
-      {
-        continue;
-      }
-      if (strcmp(key, "MemTotal:") == 0)
-      {
-        memTotal = value;
-      }
-      else if (strcmp(key, "MemFree:") == 0)
-      {
-        memFree = value;
-      }
-    }
-    fclose(fd);
+  if ((ParseMeminfo(procMeminfo.buf, keys, values, 2) != 2) || (values[0] == 0))
+  {
+    fprintf(stderr, "rpiInfo: Unable to parse /proc/meminfo pseudofile.\n");
+    return 0;
   }
-  float ramPct = (float)(memTotal - memFree) / memTotal * 100.0;
+
+  float ramPct = (float)(values[0] - values[1]) / values[0] * 100.0;
 
   /*
-  fprintf(stderr, "MemTotal: %lu, MemFree: %lu (%f %%)\n", memTotal, memFree, ramPct);
+  fprintf(stderr, "MemTotal: %llu, MemFree: %llu (%f %%)\n", values[0], values[1], ramPct);
   */
 
   return round(ramPct);
@@ -161,181 +129,524 @@ uint8_t GetFSMemoryStatfs(void)
 }
 
 /**
- * @brief Get mounted filesystem information using df/awk (better portability).
+ * @brief Get mounted filesystem information the way df reports it.
+ *
+ * Native replacement for the former "df -k / | awk" pipeline, see fsinfo.c.
  *
  * @return Used amount of FS storage in percent.
  */
 uint8_t GetFSMemoryDf(void)
 {
-  char *mnt_dir = "/";
-  FILE *fd;
-  char buffer[32] = {0};
-  uint32_t totalSize = 0;
-  uint32_t usedSize = 0;
-  uint32_t availableSize = 0;
-  uint8_t pctFree = 0;
+  return GetFSMemory();
+}
+
+/**
+ * @brief Get the CPU temperature.
+ *
+ * @return CPU temperature in Celsius or Fahrenheit (according to TEMPERATURE_TYPE setting).
+ */
+uint8_t GetCPUTemperature(void)
+{
+  unsigned int temp = 0;
 
-  fd = popen("df -k / | awk '{if (NR==2) {print $2\" \"$3\" \"$4\" \"$5+0}}'", "r");
-  if (fd == NULL)
+  if (ProcFileRead(&procThermal) < 0)
   {
-    fprintf(stderr, "rpiInfo: Unable to stat %s filesystem.\n", mnt_dir);
     return 0;
   }
 
-  fgets(buffer, sizeof(buffer), fd);
+  // Parse buffer
+  sscanf(procThermal.buf, "%u", &temp);
 
-  pclose(fd);
+  return (TEMPERATURE_TYPE == FAHRENHEIT) ? temp / 1000 * 1.8 + 32 : temp / 1000;
+}
 
-  // Parse buffer
-  sscanf(buffer, "%lu %lu %lu %u", &totalSize, &usedSize, &availableSize, &pctFree);
+// Jiffy counters from the aggregate line of /proc/stat
+struct cpustat
+{
+  uint64_t t_user;
+  uint64_t t_nice;
+  uint64_t t_system;
+  uint64_t t_idle;
+  uint64_t t_iowait;
+  uint64_t t_irq;
+  uint64_t t_softirq;
+  uint64_t t_steal;
+  uint64_t t_guest;
+  uint64_t t_guestnice;
+};
 
-  /*
-  fprintf(stderr, "(df) Disk Free: %lu B, Disk Used: %lu B (%u %%), Total: %lu B\n", availableSize, usedSize, pctFree, totalSize);
-  */
+// Snapshot the last utilization was computed against
+static struct cpustat cpuPrev;
+static int cpuPrevValid = 0;
+// Latest utilization, written by the collector thread and read by the renderer
+static _Atomic uint8_t cpuUsage = 0;
+static pthread_t collector;
+
+/**
+ * @brief Read the aggregate CPU line of /proc/stat.
+ *
+ * @param pf /proc/stat pseudofile; each thread reading it needs its own.
+ * @param st Destination for the counters.
+ * @return 0 on success, 1 on failure.
+ */
+static int ReadCPUStat(ProcFile *pf, struct cpustat *st)
+{
+  uint64_t f[10] = {0};
 
-  return pctFree;
+  if (ProcFileRead(pf) < 0)
+  {
+    return 1;
+  }
+
+  // kernels before 2.6.33 have fewer columns, only the first eight are used
+  if (ParseCPUStat(pf->buf, f, 10) < 8)
+  {
+    fprintf(stderr, "rpiInfo: Unable to parse /proc/stat pseudofile.\n");
+    return 1;
+  }
+
+  st->t_user = f[0];
+  st->t_nice = f[1];
+  st->t_system = f[2];
+  st->t_idle = f[3];
+  st->t_iowait = f[4];
+  st->t_irq = f[5];
+  st->t_softirq = f[6];
+  st->t_steal = f[7];
+  st->t_guest = f[8];
+  st->t_guestnice = f[9];
+
+  return 0;
 }
 
 /**
- * @brief Get the CPU temperature.
+ * @brief Compute utilization since the previous snapshot and publish it.
  *
- * @return CPU temperature in Celsius or Fahrenheit (according to TEMPERATURE_TYPE setting).
+ * The first call only records a snapshot.
+ *
+ * @return void
  */
-uint8_t GetCPUTemperature(void)
+static void SampleCPUUsage(void)
 {
-  FILE *fd;
-  char buffer[150] = {0};
-  uint16_t temp;
+  struct cpustat cur;
 
-  fd = fopen("/sys/class/thermal/thermal_zone0/temp", "r");
-  if (fd == NULL)
+  if (ReadCPUStat(&procStat, &cur))
   {
-    fprintf(stderr, "rpiInfo: Unable to open /sys/class/thermal/thermal_zone0/temp pseudofile.\n");
-    return 0;
+    return;
   }
 
-  fgets(buffer, sizeof(buffer), fd);
-
-  fclose(fd);
+  if (cpuPrevValid)
+  {
+    unsigned long long int prev_total = cpuPrev.t_user + cpuPrev.t_nice + cpuPrev.t_system + cpuPrev.t_idle + cpuPrev.t_iowait + cpuPrev.t_irq + cpuPrev.t_softirq + cpuPrev.t_steal;
+    unsigned long long int prev_util = cpuPrev.t_user + cpuPrev.t_nice + cpuPrev.t_system + cpuPrev.t_irq + cpuPrev.t_softirq;
+    unsigned long long int cur_total = cur.t_user + cur.t_nice + cur.t_system + cur.t_idle + cur.t_iowait + cur.t_irq + cur.t_softirq + cur.t_steal;
+    unsigned long long int cur_util = cur.t_user + cur.t_nice + cur.t_system + cur.t_irq + cur.t_softirq;
+    unsigned long int total_d = cur_total - prev_total;
+
+    // no tick elapsed since the last sample, keep the previous value
+    if (total_d > 0)
+    {
+      float cpuPct = (float)(cur_util - prev_util) / total_d * 100.0;
+      cpuUsage = round(cpuPct);
+    }
 
-  // Parse buffer
-  sscanf(buffer, "%u", &temp);
+    /*
+    fprintf(stderr, "pstat CPU %u%%\n", cpuUsage);
+    */
+  }
 
-  return (TEMPERATURE_TYPE == FAHRENHEIT) ? temp / 1000 * 1.8 + 32 : temp / 1000;
+  cpuPrev = cur;
+  cpuPrevValid = 1;
 }
 
 /**
- * @brief Get CPU usage using top/grep/awk.
+ * @brief Get CPU usage the way top reports it.
+ *
+ * Native replacement for the former "top -b -n2 -d1 | grep | awk" pipeline:
+ * us + sy + ni over a one second interval. Like top, this blocks for that
+ * interval.
  *
  * @return CPU utilization in percent.
  */
 uint8_t GetCPUUsageTop(void)
 {
-  FILE *fd;
-  char buffer[16] = {0};
+  struct cpustat a, b;
+  struct timespec interval = {1, 0};
+  uint64_t total_d = 0;
+  uint64_t util_d = 0;
 
-  fd = popen("top -b -n2 -d1 | grep -m 1 'Cpu(s)' | awk '{print $2 + $4 + $6 + $13 + $15}'", "r");
-  if (fd == NULL)
+  if (ReadCPUStat(&procStatTop, &a))
+  {
+    return 0;
+  }
+  while (nanosleep(&interval, &interval) != 0)
+    ;
+  if (ReadCPUStat(&procStatTop, &b))
   {
-    fprintf(stderr, "rpiInfo: Unable to query top for CPU usage.\n");
     return 0;
   }
 
-  fgets(buffer, sizeof(buffer), fd);
-
-  pclose(fd);
+  total_d = (b.t_user + b.t_nice + b.t_system + b.t_idle + b.t_iowait + b.t_irq + b.t_softirq + b.t_steal) -
+            (a.t_user + a.t_nice + a.t_system + a.t_idle + a.t_iowait + a.t_irq + a.t_softirq + a.t_steal);
+  util_d = (b.t_user + b.t_nice + b.t_system) - (a.t_user + a.t_nice + a.t_system);
+  if (total_d == 0)
+  {
+    return 0;
+  }
 
   /*
-  fprintf(stderr, "top CPU %f%%\n", atof(buffer));
+  fprintf(stderr, "top CPU %f%%\n", (float)util_d / total_d * 100.0);
   */
 
-  return round(atof(buffer));
+  return round((float)util_d / total_d * 100.0);
 }
 
-struct cpustat
+/**
+ * @brief Pick the configured block device with the highest utilization.
+ *
+ * @param stats Destination for its counters and rates.
+ * @return 0 on success, 1 if none of DISK_DEVICES is present.
+ */
+static uint8_t SelectBusiestDisk(DiskStats *stats)
 {
-  unsigned long int t_user;
-  unsigned long int t_nice;
-  unsigned long int t_system;
-  unsigned long int t_idle;
-  unsigned long int t_iowait;
-  unsigned long int t_irq;
-  unsigned long int t_softirq;
-  unsigned long int t_steal;
-  unsigned long int t_guest;
-  unsigned long int t_guestnice;
-};
+  DiskStats disk;
+  uint8_t found = 0;
+  uint8_t i = 0;
+
+  for (i = 0; DiskStatsGet(i, &disk) == 0; i++)
+  {
+    if (disk.present && (!found || (disk.utilPct > stats->utilPct)))
+    {
+      *stats = disk;
+      found = 1;
+    }
+  }
+
+  return !found;
+}
+
+// Working copy the collector fills source by source and publishes
+static Metrics collected;
+static EventLoop collectorLoop;
+static int collectorStopFd = -1;
+static uint8_t collectorNetWatched = 0;
 
 /**
- * @brief Get CPU usage using pstat.
+ * @brief Refresh the default interface and its address from the netlink cache.
  *
- * @return Float of CPU utilization in percent.
+ * @return 1 if either changed, 0 otherwise.
  */
-uint8_t GetCPUUsagePstat(void)
+static uint8_t CollectNetInfo(void)
 {
-  FILE *fd;
-  struct cpustat prev, cur;
+  uint8_t changed = NetInfoUpdate();
 
-  fd = fopen("/proc/stat", "r");
-  if (fd == NULL)
+  strcpy(collected.ifname, NetInfoInterface());
+  strcpy(collected.ipAddress, NetInfoAddress());
+  return changed;
+}
+
+/**
+ * @brief Copy traffic and link speed of the default interface.
+ *
+ * @return void
+ */
+static void CollectNetStats(void)
+{
+  if (NetDevGet(collected.ifname, &collected.net))
   {
-    fprintf(stderr, "rpiInfo: Unable to open /proc/stat pseudofile.\n");
-    return 0;
+    memset(&collected.net, 0, sizeof(collected.net));
+  }
+  collected.linkSpeed = NetDevLinkSpeed(collected.ifname);
+}
+
+/**
+ * @brief Refresh usage of the tracked filesystems.
+ *
+ * @return void
+ */
+static void CollectFS(void)
+{
+  const FSUsage *fs;
+  uint8_t i = 0;
+
+  FSInfoUpdate();
+  for (i = 0; (i < FS_MOUNT_MAX) && ((fs = FSInfoGet(i)) != NULL); i++)
+  {
+    collected.fs[i] = *fs;
   }
+  collected.fsCount = i;
+}
+
+/**
+ * @brief Sample the counters that are rated per interval.
+ *
+ * @return void
+ */
+static void CollectSamples(void)
+{
+  gethostname(collected.hostname, sizeof(collected.hostname) - 1);
+
+  SampleCPUUsage();
+  NetDevSample();
+  DiskStatsSample();
+
+  collected.cpuUsage = cpuUsage;
+  collected.memoryPct = GetMemory();
+  collected.temperature = GetCPUTemperature();
+  CollectNetStats();
+
+  collected.diskPresent = (SelectBusiestDisk(&collected.disk) == 0);
+  if (!collected.diskPresent)
+  {
+    memset(&collected.disk, 0, sizeof(collected.disk));
+  }
+}
+
+/**
+ * @brief Sample every source once and publish the result as the new snapshot.
+ *
+ * @return void
+ */
+static void CollectMetrics(void)
+{
+  CollectNetInfo();
+  CollectFS();
+  CollectSamples();
+  MetricsPublish(&collected);
+}
+
+static void OnSampleTimer(EventLoop *loop, uint64_t expirations, void *ctx)
+{
+  // without netlink notifications, look for address changes every interval
+  if (!collectorNetWatched)
+  {
+    CollectNetInfo();
+  }
+  CollectSamples();
+  MetricsPublish(&collected);
+}
+
+static void OnFSTimer(EventLoop *loop, uint64_t expirations, void *ctx)
+{
+  CollectFS();
+  MetricsPublish(&collected);
+}
+
+static void OnMountsChanged(EventLoop *loop, uint64_t events, void *ctx)
+{
+  // epoll has acknowledged the change, so FSInfoUpdate() would not see it
+  FSInfoChanged();
+  CollectFS();
+  MetricsPublish(&collected);
+}
 
-  fscanf(fd, "cpu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
-         &prev.t_user, &prev.t_nice, &prev.t_system, &prev.t_idle, &prev.t_iowait, &prev.t_irq, &prev.t_softirq, &prev.t_steal, &prev.t_guest, &prev.t_guestnice);
+static void OnNetlink(EventLoop *loop, uint64_t events, void *ctx)
+{
+  if (CollectNetInfo())
+  {
+    CollectNetStats();
+    MetricsPublish(&collected);
+  }
+}
+
+static void OnCollectorStop(EventLoop *loop, uint64_t events, void *ctx)
+{
+  EventLoopStop(loop);
+}
 
-  fclose(fd);
+static void *MetricsCollectorThread(void *arg)
+{
+  EventLoopRun(&collectorLoop);
+  return NULL;
+}
 
-  unsigned long long int prev_total = prev.t_user + prev.t_nice + prev.t_system + prev.t_idle + prev.t_iowait + prev.t_irq + prev.t_softirq + prev.t_steal;
-  unsigned long long int prev_util = prev.t_user + prev.t_nice + prev.t_system + prev.t_irq + prev.t_softirq;
+/**
+ * @brief Release the collector's event loop and stop descriptor.
+ *
+ * @return void
+ */
+static void MetricsCollectorClose(void)
+{
+  EventLoopClose(&collectorLoop);
+  if (collectorStopFd >= 0)
+  {
+    close(collectorStopFd);
+    collectorStopFd = -1;
+  }
+  collectorNetWatched = 0;
+}
 
-  // Wait for one second to collect data to calculate delta
-  sleep(1);
+/**
+ * @brief Start collecting metrics in the background.
+ *
+ * The collector thread runs its own event loop: a timer samples the rated
+ * counters every interval, a slower one re-reads filesystem usage, and the
+ * netlink socket and mount table are watched so address and mount changes
+ * are published as they happen. GetMetrics() and GetCPUUsagePstat() then
+ * return immediately. Start-up blocks for METRICS_PRIME_MS so that the first
+ * snapshot already carries CPU usage and traffic rates.
+ *
+ * @param intervalMs Sampling cadence in milliseconds.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t MetricsCollectorStart(uint32_t intervalMs)
+{
+  struct timespec prime = {METRICS_PRIME_MS / 1000, (METRICS_PRIME_MS % 1000) * 1000000L};
 
-  fd = fopen("/proc/stat", "r");
-  if (fd == NULL)
+  if (collectorRunning)
   {
-    fprintf(stderr, "rpiInfo: Unable to open /proc/stat pseudofile.\n");
     return 0;
   }
+  if (intervalMs == 0)
+  {
+    intervalMs = METRICS_INTERVAL_MS;
+  }
 
-  fscanf(fd, "cpu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
-         &cur.t_user, &cur.t_nice, &cur.t_system, &cur.t_idle, &cur.t_iowait, &cur.t_irq, &cur.t_softirq, &cur.t_steal, &cur.t_guest, &cur.t_guestnice);
+  // rated values need two samples: take the baseline now so the first snapshot is not all zero
+  SampleCPUUsage();
+  NetDevSample();
+  DiskStatsSample();
+  while (nanosleep(&prime, &prime) != 0)
+    ;
+  // the first snapshot also opens the netlink socket and mount table watched below
+  CollectMetrics();
 
-  fclose(fd);
+  if (EventLoopInit(&collectorLoop))
+  {
+    return 1;
+  }
+  collectorStopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if ((collectorStopFd < 0) ||
+      (EventLoopAddFd(&collectorLoop, collectorStopFd, EPOLLIN, OnCollectorStop, NULL) < 0) ||
+      (EventLoopAddTimer(&collectorLoop, intervalMs, intervalMs, OnSampleTimer, NULL) < 0) ||
+      (EventLoopAddTimer(&collectorLoop, FS_INTERVAL_MS, FS_INTERVAL_MS, OnFSTimer, NULL) < 0))
+  {
+    fprintf(stderr, "rpiInfo: Unable to set up metrics collector.\n");
+    MetricsCollectorClose();
+    return 1;
+  }
+  // optional: without them the timers poll instead
+  collectorNetWatched = (NetInfoFd() >= 0) &&
+                        (EventLoopAddFd(&collectorLoop, NetInfoFd(), EPOLLIN, OnNetlink, NULL) >= 0);
+  if (FSInfoFd() >= 0)
+  {
+    EventLoopAddFd(&collectorLoop, FSInfoFd(), EPOLLPRI, OnMountsChanged, NULL);
+  }
 
-  unsigned long long int cur_total = cur.t_user + cur.t_nice + cur.t_system + cur.t_idle + cur.t_iowait + cur.t_irq + cur.t_softirq + cur.t_steal;
-  unsigned long long int cur_util = cur.t_user + cur.t_nice + cur.t_system + cur.t_irq + cur.t_softirq;
-  unsigned long int total_d = cur_total - prev_total;
+  if (pthread_create(&collector, NULL, MetricsCollectorThread, NULL) != 0)
+  {
+    fprintf(stderr, "rpiInfo: Unable to start metrics collector thread.\n");
+    MetricsCollectorClose();
+    return 1;
+  }
+  collectorRunning = 1;
+  return 0;
+}
 
-  float cpuPct = (float)(cur_util - prev_util) / total_d * 100.0;
+/**
+ * @brief Stop the background metrics collector.
+ *
+ * @return void
+ */
+void MetricsCollectorStop(void)
+{
+  uint64_t one = 1;
 
-  /*
-  fprintf(stderr, "%lu %lu %lu %lu %lu %lu %lu %lu %lu %lu\n", prev.t_user, prev.t_nice, prev.t_system, prev.t_idle, prev.t_iowait, prev.t_irq, prev.t_softirq, prev.t_steal, prev.t_guest, prev.t_guestnice);
+  if (!collectorRunning)
+  {
+    return;
+  }
 
-  fprintf(stderr, "%lu %lu %lu %lu %lu %lu %lu %lu %lu %lu\n", cur.t_user, cur.t_nice, cur.t_system, cur.t_idle, cur.t_iowait, cur.t_irq, cur.t_softirq, cur.t_steal, cur.t_guest, cur.t_guestnice);
+  if (write(collectorStopFd, &one, sizeof(one)) != sizeof(one))
+  {
+    fprintf(stderr, "rpiInfo: Unable to stop metrics collector thread.\n");
+    return;
+  }
+  pthread_join(collector, NULL);
+  MetricsCollectorClose();
+  collectorRunning = 0;
+}
 
-  fprintf(stderr, "%lu us, %lu ni, %lu sy, %lu hi %lu si = %lu\n",
-          (cur.t_user - prev.t_user),
-          (cur.t_nice - prev.t_nice),
-          (cur.t_system - prev.t_system),
-          (cur.t_irq - prev.t_irq),
-          (cur.t_softirq - prev.t_softirq),
-          total_d);
+/**
+ * @brief Get CPU usage using pstat.
+ *
+ * Returns the value from the background collector. Without a running
+ * collector the utilization since the previous call is computed instead, so
+ * this never blocks.
+ *
+ * @return CPU utilization in percent.
+ */
+uint8_t GetCPUUsagePstat(void)
+{
+  if (!collectorRunning)
+  {
+    SampleCPUUsage();
+  }
 
-  fprintf(stderr, "%f us, %f ni, %f sy, %f hi %f si\n",
-          (float)(cur.t_user - prev.t_user) / total_d * 100.0,
-          (float)(cur.t_nice - prev.t_nice) / total_d * 100.0,
-          (float)(cur.t_system - prev.t_system) / total_d * 100.0,
-          (float)(cur.t_irq - prev.t_irq) / total_d * 100.0,
-          (float)(cur.t_softirq - prev.t_softirq) / total_d * 100.0);
+  return cpuUsage;
+}
 
-  fprintf(stderr, "%f %%\n", (float)(cur_util - prev_util) / total_d * 100.0);
+/**
+ * @brief Get traffic counters and rates of the default interface.
+ *
+ * Rates come from the background collector; without it they cover the time
+ * since the previous call.
+ *
+ * @param stats Destination for the counters and rates.
+ * @return 0 on success, 1 if the interface has no statistics.
+ */
+uint8_t GetNetThroughput(NetDevStats *stats)
+{
+  Metrics m;
 
-  fprintf(stderr, "pstat CPU %f%%\n", cpuPct);
-  */
+  if (collectorRunning)
+  {
+    // the collector thread owns the netlink socket
+    MetricsRead(&m);
+    *stats = m.net;
+    return (m.net.name[0] == '\0');
+  }
+
+  NetInfoUpdate();
+  NetDevSample();
+
+  return NetDevGet(NetInfoInterface(), stats);
+}
+
+/**
+ * @brief Get I/O rates of the busiest configured block device.
+ *
+ * Rates come from the background collector; without it they cover the time
+ * since the previous call.
+ *
+ * @param stats Destination for the counters and rates.
+ * @return 0 on success, 1 if none of DISK_DEVICES is present.
+ */
+uint8_t GetDiskIO(DiskStats *stats)
+{
+  if (!collectorRunning)
+  {
+    DiskStatsSample();
+  }
+
+  return SelectBusiestDisk(stats);
+}
+
+/**
+ * @brief Get the latest metrics snapshot.
+ *
+ * Never blocks while the collector runs; without it, all sources are sampled
+ * inline first.
+ *
+ * @param m Destination for the snapshot.
+ * @return void
+ */
+void GetMetrics(Metrics *m)
+{
+  if (!collectorRunning)
+  {
+    CollectMetrics();
+  }
 
-  return round(cpuPct);
+  MetricsRead(m);
 }
@@ -2,6 +2,9 @@
 #define __RPIINFO_H
 
 #include <stdint.h>
+#include "diskstats.h"
+#include "metrics.h"
+#include "netdev.h"
 
 /**********Select display temperature type**************/
 #define CELSIUS 0
@@ -17,6 +20,24 @@
 #define CUSTOM_DISPLAY ""
 /************************Turn off the IP display. Can customize the display****************/
 
+/**********Metrics collection cadence (ms)**************/
+#define METRICS_INTERVAL_MS 1000
+// Filesystem usage changes slowly; mounts and unmounts are picked up immediately
+#define FS_INTERVAL_MS 5000
+// Baseline taken this long before the first snapshot, so it already has CPU usage and rates
+#define METRICS_PRIME_MS 250
+
+/**********Filesystems shown on the disk page besides the root filesystem**************/
+// Comma-separated mount points, e.g. "/boot/firmware,/mnt/data". Empty for root only.
+#define FS_MOUNT_POINTS ""
+
+/**********Full scale of the network page bar when the link speed is unknown (Mbit/s)**************/
+#define NET_SPEED_FALLBACK_MBPS 100
+
+/**********Block devices considered for the I/O page (busiest one is shown)**************/
+// Comma-separated names as in /proc/diskstats: SD card, NVMe and USB boot devices
+#define DISK_DEVICES "mmcblk0,nvme0n1,sda"
+
 char *GetIPAddress(void);
 uint8_t GetMemory(void);
 uint8_t GetFSMemoryStatfs(void);
@@ -24,5 +45,10 @@ uint8_t GetFSMemoryDf(void);
 uint8_t GetCPUTemperature(void);
 uint8_t GetCPUUsageTop(void);
 uint8_t GetCPUUsagePstat(void);
+uint8_t MetricsCollectorStart(uint32_t intervalMs);
+void MetricsCollectorStop(void);
+uint8_t GetNetThroughput(NetDevStats *stats);
+uint8_t GetDiskIO(DiskStats *stats);
+void GetMetrics(Metrics *m);
 
 #endif /*__RPIINFO_H*/
\ No newline at end of file
@@ -0,0 +1,338 @@
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "drawqueue.h"
+#include "st7735.h"
+
+/*
+ * A bounded multi-producer, single-consumer ring of draw commands.
+ *
+ * Any thread may post; only the thread that draws the pages (and owns the
+ * framebuffer) applies them, in lcd_flush() or draw_queue_run(). Posting
+ * never waits for the bus or for a lock: a producer claims a slot with one
+ * compare-and-swap on the enqueue position, fills it, and publishes it by
+ * storing the slot's sequence number. Once the ring is full a post fails
+ * instead of blocking and the command is counted as dropped.
+ *
+ * Each slot's sequence says whose turn it is, counted from the first
+ * position of the lap (position with the slot bits cleared): equal to it when
+ * free for that lap's producer, one more once filled for the consumer. The
+ * zeroed ring is therefore empty without any set-up. A producer that claimed
+ * a slot but has not filled it yet holds back the slots behind it; the
+ * consumer stops there and picks them up later.
+ */
+
+enum
+{
+    DRAW_FILL = 0,
+    DRAW_TEXT,
+    DRAW_BLIT,
+    DRAW_FLUSH
+};
+
+typedef struct
+{
+    _Atomic uint32_t sequence;
+    uint8_t type;
+    uint8_t font;
+    uint16_t x;
+    uint16_t y;
+    uint16_t w;
+    uint16_t h;
+    uint16_t color;
+    uint16_t bgcolor;
+    union
+    {
+        char text[DRAW_QUEUE_TEXT_MAX];
+        const uint8_t *data;
+    };
+} DrawCommand;
+
+static DrawCommand draw_queue[DRAW_QUEUE_SLOTS];
+static _Atomic uint32_t draw_queue_head = 0;
+static uint32_t draw_queue_tail = 0;
+static _Atomic uint32_t draw_queue_drops = 0;
+static _Atomic int draw_queue_wake = -1;
+
+// first position of the lap a position belongs to
+#define DRAW_QUEUE_LAP(pos) ((pos) & ~(uint32_t)(DRAW_QUEUE_SLOTS - 1))
+
+/**
+ * @brief Claim the next free slot.
+ *
+ * @return Slot to fill and publish, NULL when the ring is full.
+ */
+static DrawCommand *draw_queue_claim(void)
+{
+    DrawCommand *cmd;
+    uint32_t pos = atomic_load_explicit(&draw_queue_head, memory_order_relaxed);
+    int32_t diff = 0;
+
+    for (;;)
+    {
+        cmd = &draw_queue[pos & (DRAW_QUEUE_SLOTS - 1)];
+        diff = (int32_t)(atomic_load_explicit(&cmd->sequence, memory_order_acquire) - DRAW_QUEUE_LAP(pos));
+        if (diff == 0)
+        {
+            // free for this lap; on failure pos is reloaded and we retry
+            if (atomic_compare_exchange_weak_explicit(&draw_queue_head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                return cmd;
+        }
+        else if (diff < 0)
+        {
+            // still holds the previous lap's command
+            atomic_fetch_add_explicit(&draw_queue_drops, 1, memory_order_relaxed);
+            return NULL;
+        }
+        else
+        {
+            // another producer took it
+            pos = atomic_load_explicit(&draw_queue_head, memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief Hand a filled slot to the consumer.
+ *
+ * @param cmd Slot returned by draw_queue_claim().
+ * @return void
+ */
+static void draw_queue_publish(DrawCommand *cmd)
+{
+    uint32_t pos = atomic_load_explicit(&cmd->sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&cmd->sequence, pos + 1, memory_order_release);
+}
+
+/**
+ * @brief Queue a filled rectangle.
+ *
+ * @param x X-coordinate of rectangle origin.
+ * @param y Y-coordinate of rectangle origin.
+ * @param w Width of rectangle.
+ * @param h Height of rectangle.
+ * @param color Fill color.
+ * @return 0 on success, 1 if the queue is full.
+ */
+uint8_t draw_queue_fill(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+    DrawCommand *cmd = draw_queue_claim();
+
+    if (cmd == NULL)
+        return 1;
+    cmd->type = DRAW_FILL;
+    cmd->x = x;
+    cmd->y = y;
+    cmd->w = w;
+    cmd->h = h;
+    cmd->color = color;
+    draw_queue_publish(cmd);
+    return 0;
+}
+
+/**
+ * @brief Queue a string; it is copied, so the caller's buffer may be reused.
+ *
+ * @param x X-coordinate of the first character.
+ * @param y Y-coordinate of the first character.
+ * @param str String, truncated to DRAW_QUEUE_TEXT_MAX - 1 characters.
+ * @param font Font type.
+ * @param color Text color.
+ * @param bgcolor Background color.
+ * @return 0 on success, 1 if the queue is full.
+ */
+uint8_t draw_queue_text(uint16_t x, uint16_t y, const char *str, FontType font, uint16_t color, uint16_t bgcolor)
+{
+    DrawCommand *cmd = draw_queue_claim();
+
+    if (cmd == NULL)
+        return 1;
+    cmd->type = DRAW_TEXT;
+    cmd->font = font;
+    cmd->x = x;
+    cmd->y = y;
+    cmd->color = color;
+    cmd->bgcolor = bgcolor;
+    snprintf(cmd->text, sizeof(cmd->text), "%s", str);
+    draw_queue_publish(cmd);
+    return 0;
+}
+
+/**
+ * @brief Queue an RGB565 image.
+ *
+ * Only the pointer is queued: the pixels must stay unchanged until the
+ * command has been applied, which suits icons and other static images.
+ *
+ * @param x X-coordinate of image origin.
+ * @param y Y-coordinate of image origin.
+ * @param w Width of image in pixels.
+ * @param h Height of image in pixels.
+ * @param data Image pixels, as for lcd_draw_image().
+ * @return 0 on success, 1 if the queue is full.
+ */
+uint8_t draw_queue_blit(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *data)
+{
+    DrawCommand *cmd = draw_queue_claim();
+
+    if (cmd == NULL)
+        return 1;
+    cmd->type = DRAW_BLIT;
+    cmd->x = x;
+    cmd->y = y;
+    cmd->w = w;
+    cmd->h = h;
+    cmd->data = data;
+    draw_queue_publish(cmd);
+    return 0;
+}
+
+/**
+ * @brief Ask for the commands queued so far to be put on the panel.
+ *
+ * Wakes the consumer through draw_queue_fd(); without this, queued commands
+ * wait for the next lcd_flush() of the page loop.
+ *
+ * @return 0 on success, 1 if the queue is full.
+ */
+uint8_t draw_queue_flush(void)
+{
+    DrawCommand *cmd = draw_queue_claim();
+    uint64_t one = 1;
+    int wake = -1;
+
+    if (cmd == NULL)
+        return 1;
+    cmd->type = DRAW_FLUSH;
+    draw_queue_publish(cmd);
+
+    wake = atomic_load_explicit(&draw_queue_wake, memory_order_relaxed);
+    if ((wake >= 0) && (write(wake, &one, sizeof(one)) != sizeof(one)))
+        fprintf(stderr, "st7735: Unable to wake draw queue\n");
+    return 0;
+}
+
+/**
+ * @brief Apply one command to the framebuffer.
+ *
+ * @param cmd Command taken from the ring.
+ * @return void
+ */
+static void draw_queue_draw(DrawCommand *cmd)
+{
+    switch (cmd->type)
+    {
+    case DRAW_FILL:
+        lcd_fill_rectangle(cmd->x, cmd->y, cmd->w, cmd->h, cmd->color);
+        break;
+    case DRAW_TEXT:
+        lcd_write_str(cmd->x, cmd->y, cmd->text, cmd->font, cmd->color, cmd->bgcolor);
+        break;
+    case DRAW_BLIT:
+        lcd_draw_image(cmd->x, cmd->y, cmd->w, cmd->h, (uint8_t *)cmd->data);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Draw the queued commands into the framebuffer.
+ *
+ * Consumer side: call only from the thread that draws the pages. lcd_flush()
+ * calls it first, so queued drawing lands on top of the current page.
+ * Stops at a slot another thread has claimed but not filled yet.
+ *
+ * @return 1 if a flush was requested among the applied commands, 0 otherwise.
+ */
+uint8_t draw_queue_apply(void)
+{
+    DrawCommand *cmd;
+    uint8_t flush = 0;
+
+    for (;;)
+    {
+        cmd = &draw_queue[draw_queue_tail & (DRAW_QUEUE_SLOTS - 1)];
+        if (atomic_load_explicit(&cmd->sequence, memory_order_acquire) != DRAW_QUEUE_LAP(draw_queue_tail) + 1)
+            break;
+        if (cmd->type == DRAW_FLUSH)
+            flush = 1;
+        else
+            draw_queue_draw(cmd);
+        // free the slot for the producer one lap ahead
+        atomic_store_explicit(&cmd->sequence, DRAW_QUEUE_LAP(draw_queue_tail) + DRAW_QUEUE_SLOTS, memory_order_release);
+        draw_queue_tail++;
+    }
+    return flush;
+}
+
+/**
+ * @brief Handle a draw_queue_fd() wakeup: apply the queue and flush if asked.
+ *
+ * Waits for producers still filling slots claimed before the wakeup, so a
+ * flush request is never left behind an unfinished command.
+ *
+ * @return void
+ */
+void draw_queue_run(void)
+{
+    uint64_t wakeups = 0;
+    uint32_t end = 0;
+    uint8_t flush = 0;
+    int wake = atomic_load_explicit(&draw_queue_wake, memory_order_relaxed);
+
+    if ((wake >= 0) && (read(wake, &wakeups, sizeof(wakeups)) < 0))
+        wakeups = 0;
+    // every flush that woke us was claimed before this
+    end = atomic_load_explicit(&draw_queue_head, memory_order_acquire);
+
+    flush = draw_queue_apply();
+    while ((int32_t)(end - draw_queue_tail) > 0)
+    {
+        // a producer is between claiming and publishing; it never blocks there
+        sched_yield();
+        flush |= draw_queue_apply();
+    }
+    if (flush)
+        lcd_flush();
+}
+
+/**
+ * @brief Descriptor that becomes readable when a producer calls draw_queue_flush().
+ *
+ * Created on first use; call it from the consumer thread before starting
+ * producers, and watch it with EPOLLIN, calling draw_queue_run() when ready.
+ *
+ * @return eventfd, -1 on failure.
+ */
+int draw_queue_fd(void)
+{
+    int wake = atomic_load_explicit(&draw_queue_wake, memory_order_relaxed);
+
+    if (wake >= 0)
+        return wake;
+
+    wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake < 0)
+    {
+        fprintf(stderr, "st7735: Unable to create draw queue eventfd\n");
+        return -1;
+    }
+    atomic_store_explicit(&draw_queue_wake, wake, memory_order_release);
+    return wake;
+}
+
+/**
+ * @brief Count commands rejected because the queue was full.
+ *
+ * @return Drops since start-up.
+ */
+uint32_t draw_queue_dropped(void)
+{
+    return atomic_load_explicit(&draw_queue_drops, memory_order_relaxed);
+}
@@ -0,0 +1,30 @@
+#ifndef __DRAWQUEUE_H__
+#define __DRAWQUEUE_H__
+
+#include <stdint.h>
+#include "st7735.h"
+
+// Commands waiting to be drawn, power of two
+#define DRAW_QUEUE_SLOTS 64
+// Longest string a text command carries
+#define DRAW_QUEUE_TEXT_MAX 24
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  extern uint8_t draw_queue_fill(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
+  extern uint8_t draw_queue_text(uint16_t x, uint16_t y, const char *str, FontType font, uint16_t color, uint16_t bgcolor);
+  extern uint8_t draw_queue_blit(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *data);
+  extern uint8_t draw_queue_flush(void);
+  extern uint8_t draw_queue_apply(void);
+  extern void draw_queue_run(void);
+  extern int draw_queue_fd(void);
+  extern uint32_t draw_queue_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __DRAWQUEUE_H__
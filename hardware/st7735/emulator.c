@@ -0,0 +1,248 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "emulator.h"
+#include "st7735.h"
+
+/*
+ * Software model of the UCTRONICS I2C bridge as driven by st7735.c.
+ *
+ * Outside burst mode every message is a 3-byte register write:
+ *   X_COORDINATE_REG / Y_COORDINATE_REG  window start and end (panel RAM coordinates)
+ *   CHAR_DATA_REG                        start a RAM write at the window origin
+ *   WRITE_DATA_REG                       one big-endian RGB565 pixel at the cursor
+ *   BURST_WRITE_REG 00 01                enter burst mode
+ *   SYNC_REG                             present
+ * In burst mode every message is raw pixel data until BURST_WRITE_REG 00 00.
+ * The cursor advances left to right, top to bottom, and wraps inside the window.
+ */
+
+static uint16_t emulator_ram[EMULATOR_RAM_HEIGHT][EMULATOR_RAM_WIDTH];
+static uint8_t emulator_x0, emulator_x1, emulator_y0, emulator_y1;
+static uint16_t emulator_cx, emulator_cy;
+static bool emulator_burst = false;
+// High byte of a pixel split across two burst messages
+static int16_t emulator_carry = -1;
+static EmulatorStats emulator_stats;
+static const char *emulator_path = NULL;
+
+/**
+ * @brief Clear the modelled panel, window state and counters.
+ *
+ * @return void
+ */
+void emulator_reset(void)
+{
+    memset(emulator_ram, 0, sizeof(emulator_ram));
+    memset(&emulator_stats, 0, sizeof(emulator_stats));
+    emulator_x0 = emulator_y0 = 0;
+    emulator_x1 = emulator_y1 = 0;
+    emulator_cx = emulator_cy = 0;
+    emulator_burst = false;
+    emulator_carry = -1;
+}
+
+static void emulator_write_pixel(uint8_t high, uint8_t low)
+{
+    // below the offset wraps around to a large value, so one unsigned test checks both sides
+    if (((uint16_t)(emulator_cx - ST7735_XSTART) >= ST7735_WIDTH) ||
+        ((uint16_t)(emulator_cy - ST7735_YSTART) >= ST7735_HEIGHT))
+    {
+        emulator_stats.violations++;
+    }
+    emulator_ram[emulator_cy][emulator_cx] = (high << 8) | low;
+    emulator_stats.pixels++;
+
+    if (++emulator_cx > emulator_x1)
+    {
+        emulator_cx = emulator_x0;
+        if (++emulator_cy > emulator_y1)
+        {
+            emulator_cy = emulator_y0;
+        }
+    }
+}
+
+/**
+ * @brief Decode one I2C message addressed to the bridge.
+ *
+ * @param buff Message bytes.
+ * @param length Message length.
+ * @return void
+ */
+void emulator_message(const uint8_t *buff, uint32_t length)
+{
+    uint32_t i = 0;
+
+    emulator_stats.messages++;
+    emulator_stats.bytes += length;
+
+    if (emulator_burst)
+    {
+        if ((length == 3) && (buff[0] == BURST_WRITE_REG) && (buff[1] == 0x00) && (buff[2] == 0x00))
+        {
+            emulator_burst = false;
+            if (emulator_carry >= 0)
+            {
+                emulator_stats.violations++;
+                emulator_carry = -1;
+            }
+            return;
+        }
+        if ((emulator_carry >= 0) && (length > 0))
+        {
+            emulator_write_pixel(emulator_carry, buff[0]);
+            emulator_carry = -1;
+            i = 1;
+        }
+        for (; i + 1 < length; i += 2)
+        {
+            emulator_write_pixel(buff[i], buff[i + 1]);
+        }
+        if (i < length)
+        {
+            emulator_carry = buff[i];
+        }
+        return;
+    }
+
+    if (length != 3)
+    {
+        emulator_stats.violations++;
+        return;
+    }
+
+    switch (buff[0])
+    {
+    case X_COORDINATE_REG:
+        emulator_x0 = buff[1];
+        emulator_x1 = buff[2];
+        break;
+    case Y_COORDINATE_REG:
+        emulator_y0 = buff[1];
+        emulator_y1 = buff[2];
+        break;
+    case CHAR_DATA_REG:
+        emulator_cx = emulator_x0;
+        emulator_cy = emulator_y0;
+        emulator_stats.windows++;
+        break;
+    case WRITE_DATA_REG:
+        emulator_write_pixel(buff[1], buff[2]);
+        break;
+    case BURST_WRITE_REG:
+        if (buff[2] == 0x01)
+        {
+            emulator_burst = true;
+            emulator_stats.bursts++;
+        }
+        break;
+    case SYNC_REG:
+        emulator_stats.syncs++;
+        break;
+    default:
+        emulator_stats.violations++;
+        break;
+    }
+}
+
+/**
+ * @brief Read back a pixel of the visible panel.
+ *
+ * @param x X-coordinate in display coordinates.
+ * @param y Y-coordinate in display coordinates.
+ * @return RGB565 color.
+ */
+uint16_t emulator_pixel(uint16_t x, uint16_t y)
+{
+    return emulator_ram[y + ST7735_YSTART][x + ST7735_XSTART];
+}
+
+/**
+ * @brief Copy the wire-level counters.
+ *
+ * @param stats Destination for the counters.
+ * @return void
+ */
+void emulator_get_stats(EmulatorStats *stats)
+{
+    *stats = emulator_stats;
+}
+
+/**
+ * @brief Write the visible panel as a binary PPM image.
+ *
+ * @param path Image file to write.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t emulator_dump_ppm(const char *path)
+{
+    FILE *fd;
+    uint16_t x = 0;
+    uint16_t y = 0;
+    uint16_t c = 0;
+
+    fd = fopen(path, "wb");
+    if (fd == NULL)
+    {
+        fprintf(stderr, "emulator: Unable to write %s\n", path);
+        return 1;
+    }
+
+    fprintf(fd, "P6\n%u %u\n255\n", ST7735_WIDTH, ST7735_HEIGHT);
+    for (y = 0; y < ST7735_HEIGHT; y++)
+    {
+        for (x = 0; x < ST7735_WIDTH; x++)
+        {
+            c = emulator_pixel(x, y);
+            fputc(((c >> 11) & 0x1F) * 255 / 31, fd);
+            fputc(((c >> 5) & 0x3F) * 255 / 63, fd);
+            fputc((c & 0x1F) * 255 / 31, fd);
+        }
+    }
+
+    fclose(fd);
+    return 0;
+}
+
+/******************************** transport ********************************/
+
+static int emulator_open(const char *arg)
+{
+    emulator_path = (arg != NULL) ? arg : "st7735.ppm";
+    emulator_reset();
+    return 0;
+}
+
+static int emulator_write(const uint8_t *buff, uint32_t length)
+{
+    emulator_message(buff, length);
+    return length;
+}
+
+static int emulator_write_commands(const uint8_t *data, uint32_t count)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        emulator_message(data + i * 3, 3);
+    }
+    return 0;
+}
+
+static void emulator_delay(uint32_t us)
+{
+    // decoding is instantaneous, pacing has no effect on the model
+    (void)us;
+}
+
+static void emulator_close(void)
+{
+    fprintf(stderr, "emulator: %u messages, %u bytes, %u windows, %u pixels, %u bursts, %u syncs, %u violations\n",
+            emulator_stats.messages, emulator_stats.bytes, emulator_stats.windows, emulator_stats.pixels,
+            emulator_stats.bursts, emulator_stats.syncs, emulator_stats.violations);
+    emulator_dump_ppm(emulator_path);
+}
+
+const Transport transport_emulator = {"emu", emulator_open, emulator_write, emulator_write_commands, emulator_delay, emulator_close, NULL};
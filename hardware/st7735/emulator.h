@@ -0,0 +1,40 @@
+#ifndef __EMULATOR_H__
+#define __EMULATOR_H__
+
+#include <stdint.h>
+#include "transport.h"
+
+// Controller RAM modelled by the emulator, large enough for any 8-bit window register
+#define EMULATOR_RAM_WIDTH 256
+#define EMULATOR_RAM_HEIGHT 256
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // Wire-level counters collected while decoding
+  typedef struct EmulatorStats
+  {
+    uint32_t messages;   // I2C messages received
+    uint32_t bytes;      // bytes received
+    uint32_t windows;    // address windows opened (CHAR_DATA_REG)
+    uint32_t pixels;     // pixels written, single or burst
+    uint32_t bursts;     // BURST_WRITE_REG start/stop pairs
+    uint32_t syncs;      // SYNC_REG writes
+    uint32_t violations; // malformed messages or pixels outside the panel
+  } EmulatorStats;
+
+  extern void emulator_reset(void);
+  extern void emulator_message(const uint8_t *buff, uint32_t length);
+  extern uint16_t emulator_pixel(uint16_t x, uint16_t y);
+  extern void emulator_get_stats(EmulatorStats *stats);
+  extern uint8_t emulator_dump_ppm(const char *path);
+
+  extern const Transport transport_emulator;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __EMULATOR_H__
@@ -0,0 +1,226 @@
+#include <pthread.h>
+#include <string.h>
+#include "expand.h"
+
+/*
+ * 1bpp to big-endian RGB565 expansion.
+ *
+ * Each row is 16 bits, most significant bit leftmost (the FontDef layout);
+ * set bits become color, clear bits bgcolor. The vector kernels build a lane
+ * mask per pixel by testing the row against {0x8000, 0x4000, ...} and select
+ * between the two byte-swapped colors, producing 16 pixels per row at once.
+ * Rows narrower than 16 pixels are stored whole when the destination rows are
+ * packed (stride == width * 2) and the spill stays inside the destination, as
+ * the next row overwrites it; otherwise they are staged through a small buffer
+ * so nothing past width is written.
+ */
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define EXPAND_HAVE_AVX2 1
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+typedef void (*ExpandFn)(const uint16_t *rows, uint16_t count, uint8_t width, uint16_t color, uint16_t bgcolor, uint8_t *dst, uint32_t stride);
+
+// True when a full 16-pixel store for this row stays inside packed destination rows
+static inline int expand_spill_ok(uint16_t i, uint16_t count, uint8_t width, uint32_t stride)
+{
+    return (width == 16) || ((stride == (uint32_t)width * 2) && (i * stride + 32 <= count * stride));
+}
+
+// Pixel value that lands in memory as big-endian bytes when stored natively
+static inline uint16_t expand_wire(uint16_t color)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    return color;
+#else
+    return (uint16_t)((color << 8) | (color >> 8));
+#endif
+}
+
+static void expand_scalar(const uint16_t *rows, uint16_t count, uint8_t width, uint16_t color, uint16_t bgcolor, uint8_t *dst, uint32_t stride)
+{
+    uint16_t i = 0;
+    uint8_t j = 0;
+    uint16_t b = 0;
+    uint16_t c = 0;
+    uint8_t *p;
+
+    for (i = 0; i < count; i++)
+    {
+        b = rows[i];
+        p = dst + i * stride;
+        for (j = 0; j < width; j++)
+        {
+            c = ((b << j) & 0x8000) ? color : bgcolor;
+            *p++ = c >> 8;
+            *p++ = c & 0xFF;
+        }
+    }
+}
+
+#if defined(__SSE2__)
+static void expand_sse2(const uint16_t *rows, uint16_t count, uint8_t width, uint16_t color, uint16_t bgcolor, uint8_t *dst, uint32_t stride)
+{
+    const __m128i fg = _mm_set1_epi16((short)expand_wire(color));
+    const __m128i bg = _mm_set1_epi16((short)expand_wire(bgcolor));
+    const __m128i bitsLo = _mm_setr_epi16((short)0x8000, 0x4000, 0x2000, 0x1000, 0x0800, 0x0400, 0x0200, 0x0100);
+    const __m128i bitsHi = _mm_setr_epi16(0x0080, 0x0040, 0x0020, 0x0010, 0x0008, 0x0004, 0x0002, 0x0001);
+    const __m128i zero = _mm_setzero_si128();
+    uint8_t staging[32];
+    uint16_t i = 0;
+    __m128i row, mask, lo, hi;
+
+    for (i = 0; i < count; i++)
+    {
+        row = _mm_set1_epi16((short)rows[i]);
+        // lanes whose bit is clear compare equal to zero and select bgcolor
+        mask = _mm_cmpeq_epi16(_mm_and_si128(row, bitsLo), zero);
+        lo = _mm_or_si128(_mm_and_si128(mask, bg), _mm_andnot_si128(mask, fg));
+        mask = _mm_cmpeq_epi16(_mm_and_si128(row, bitsHi), zero);
+        hi = _mm_or_si128(_mm_and_si128(mask, bg), _mm_andnot_si128(mask, fg));
+        if (expand_spill_ok(i, count, width, stride))
+        {
+            _mm_storeu_si128((__m128i *)(dst + i * stride), lo);
+            _mm_storeu_si128((__m128i *)(dst + i * stride + 16), hi);
+        }
+        else
+        {
+            _mm_storeu_si128((__m128i *)staging, lo);
+            _mm_storeu_si128((__m128i *)(staging + 16), hi);
+            memcpy(dst + i * stride, staging, width * 2);
+        }
+    }
+}
+#endif
+
+#if defined(EXPAND_HAVE_AVX2)
+__attribute__((target("avx2"))) static void expand_avx2(const uint16_t *rows, uint16_t count, uint8_t width, uint16_t color, uint16_t bgcolor, uint8_t *dst, uint32_t stride)
+{
+    const __m256i fg = _mm256_set1_epi16((short)expand_wire(color));
+    const __m256i bg = _mm256_set1_epi16((short)expand_wire(bgcolor));
+    const __m256i bits = _mm256_setr_epi16((short)0x8000, 0x4000, 0x2000, 0x1000, 0x0800, 0x0400, 0x0200, 0x0100,
+                                           0x0080, 0x0040, 0x0020, 0x0010, 0x0008, 0x0004, 0x0002, 0x0001);
+    const __m256i zero = _mm256_setzero_si256();
+    uint8_t staging[32];
+    uint16_t i = 0;
+    __m256i mask, px;
+
+    for (i = 0; i < count; i++)
+    {
+        mask = _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_set1_epi16((short)rows[i]), bits), zero);
+        px = _mm256_blendv_epi8(fg, bg, mask);
+        if (expand_spill_ok(i, count, width, stride))
+        {
+            _mm256_storeu_si256((__m256i *)(dst + i * stride), px);
+        }
+        else
+        {
+            _mm256_storeu_si256((__m256i *)staging, px);
+            memcpy(dst + i * stride, staging, width * 2);
+        }
+    }
+}
+#endif
+
+#if defined(__ARM_NEON)
+static void expand_neon(const uint16_t *rows, uint16_t count, uint8_t width, uint16_t color, uint16_t bgcolor, uint8_t *dst, uint32_t stride)
+{
+    static const uint16_t bitsLoInit[8] = {0x8000, 0x4000, 0x2000, 0x1000, 0x0800, 0x0400, 0x0200, 0x0100};
+    static const uint16_t bitsHiInit[8] = {0x0080, 0x0040, 0x0020, 0x0010, 0x0008, 0x0004, 0x0002, 0x0001};
+    const uint16x8_t fg = vdupq_n_u16(expand_wire(color));
+    const uint16x8_t bg = vdupq_n_u16(expand_wire(bgcolor));
+    const uint16x8_t bitsLo = vld1q_u16(bitsLoInit);
+    const uint16x8_t bitsHi = vld1q_u16(bitsHiInit);
+    uint16_t staging[16];
+    uint16_t i = 0;
+    uint16x8_t row, lo, hi;
+
+    for (i = 0; i < count; i++)
+    {
+        row = vdupq_n_u16(rows[i]);
+        // vtst sets lanes whose bit is set, vbsl picks color there
+        lo = vbslq_u16(vtstq_u16(row, bitsLo), fg, bg);
+        hi = vbslq_u16(vtstq_u16(row, bitsHi), fg, bg);
+        if (expand_spill_ok(i, count, width, stride))
+        {
+            vst1q_u8(dst + i * stride, vreinterpretq_u8_u16(lo));
+            vst1q_u8(dst + i * stride + 16, vreinterpretq_u8_u16(hi));
+        }
+        else
+        {
+            vst1q_u16(staging, lo);
+            vst1q_u16(staging + 8, hi);
+            memcpy(dst + i * stride, staging, width * 2);
+        }
+    }
+}
+#endif
+
+// Chosen once, by whichever drawing thread gets there first
+static pthread_once_t expand_once = PTHREAD_ONCE_INIT;
+static ExpandFn expand_kernel = NULL;
+static const char *expand_name = "scalar";
+
+static void expand_select(void)
+{
+    ExpandFn kernel = expand_scalar;
+    const char *name = "scalar";
+
+#if defined(__ARM_NEON)
+    kernel = expand_neon;
+    name = "neon";
+#endif
+#if defined(__SSE2__)
+    kernel = expand_sse2;
+    name = "sse2";
+#endif
+#if defined(EXPAND_HAVE_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        kernel = expand_avx2;
+        name = "avx2";
+    }
+#endif
+    // the pointer last, so it never names a kernel before its name is set
+    expand_name = name;
+    expand_kernel = kernel;
+}
+
+/**
+ * @brief Expand 16-bit 1bpp rows into big-endian RGB565 pixels.
+ *
+ * Uses the fastest kernel available on this CPU (AVX2, SSE2, NEON or scalar).
+ *
+ * @param rows Mask rows, bit 15 is the leftmost pixel.
+ * @param count Number of rows.
+ * @param width Pixels per row to produce (1..16).
+ * @param color Color for set bits.
+ * @param bgcolor Color for clear bits.
+ * @param dst Destination of the first row.
+ * @param stride Distance in bytes between destination rows.
+ * @return void
+ */
+void expand_mask16(const uint16_t *rows, uint16_t count, uint8_t width, uint16_t color, uint16_t bgcolor, uint8_t *dst, uint32_t stride)
+{
+    pthread_once(&expand_once, expand_select);
+    expand_kernel(rows, count, width, color, bgcolor, dst, stride);
+}
+
+/**
+ * @brief Name the kernel expand_mask16() dispatches to.
+ *
+ * @return "avx2", "sse2", "neon" or "scalar".
+ */
+const char *expand_kernel_name(void)
+{
+    pthread_once(&expand_once, expand_select);
+    return expand_name;
+}
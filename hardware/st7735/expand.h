@@ -0,0 +1,18 @@
+#ifndef __EXPAND_H__
+#define __EXPAND_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  extern void expand_mask16(const uint16_t *rows, uint16_t count, uint8_t width, uint16_t color, uint16_t bgcolor, uint8_t *dst, uint32_t stride);
+  extern const char *expand_kernel_name(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __EXPAND_H__
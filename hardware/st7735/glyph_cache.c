@@ -0,0 +1,163 @@
+#include <string.h>
+#include "expand.h"
+#include "glyph_cache.h"
+
+/*
+ * Expanded glyphs are stored as big-endian RGB565, font.width pixels per row,
+ * ready to be copied into the framebuffer. Slots come from a fixed arena and
+ * are recycled least recently used first.
+ */
+
+#define GLYPH_CACHE_NONE 0xFF
+
+typedef struct
+{
+    const uint16_t *font; // font.data identifies the font
+    uint16_t color;
+    uint16_t bgcolor;
+    char ch;
+    uint8_t next;  // hash chain
+    uint8_t older; // LRU list
+    uint8_t newer;
+} GlyphSlot;
+
+static uint8_t glyph_arena[GLYPH_CACHE_SLOTS][GLYPH_CACHE_SLOT_BYTES];
+static GlyphSlot glyph_slots[GLYPH_CACHE_SLOTS];
+static uint8_t glyph_buckets[GLYPH_CACHE_BUCKETS];
+static uint8_t glyph_newest = GLYPH_CACHE_NONE;
+static uint8_t glyph_oldest = GLYPH_CACHE_NONE;
+static uint8_t glyph_count = 0;
+static uint8_t glyph_ready = 0;
+static GlyphCacheStats glyph_stats;
+
+static uint32_t glyph_hash(char ch, const uint16_t *font, uint16_t color, uint16_t bgcolor)
+{
+    uint32_t h = (uint32_t)(uintptr_t)font;
+
+    h = (h ^ (uint8_t)ch) * 0x9E3779B1u;
+    h = (h ^ color) * 0x9E3779B1u;
+    h = (h ^ bgcolor) * 0x9E3779B1u;
+    return (h >> 16) & (GLYPH_CACHE_BUCKETS - 1);
+}
+
+static void glyph_unlink_lru(uint8_t i)
+{
+    if (glyph_slots[i].older != GLYPH_CACHE_NONE)
+        glyph_slots[glyph_slots[i].older].newer = glyph_slots[i].newer;
+    else
+        glyph_oldest = glyph_slots[i].newer;
+    if (glyph_slots[i].newer != GLYPH_CACHE_NONE)
+        glyph_slots[glyph_slots[i].newer].older = glyph_slots[i].older;
+    else
+        glyph_newest = glyph_slots[i].older;
+}
+
+static void glyph_push_newest(uint8_t i)
+{
+    glyph_slots[i].older = glyph_newest;
+    glyph_slots[i].newer = GLYPH_CACHE_NONE;
+    if (glyph_newest != GLYPH_CACHE_NONE)
+        glyph_slots[glyph_newest].newer = i;
+    glyph_newest = i;
+    if (glyph_oldest == GLYPH_CACHE_NONE)
+        glyph_oldest = i;
+}
+
+static void glyph_unlink_bucket(uint8_t i)
+{
+    GlyphSlot *s = &glyph_slots[i];
+    uint8_t *link = &glyph_buckets[glyph_hash(s->ch, s->font, s->color, s->bgcolor)];
+
+    while (*link != i)
+        link = &glyph_slots[*link].next;
+    *link = s->next;
+}
+
+/**
+ * @brief Empty the cache and zero its statistics.
+ *
+ * @return void
+ */
+void glyph_cache_reset(void)
+{
+    memset(glyph_buckets, GLYPH_CACHE_NONE, sizeof(glyph_buckets));
+    memset(&glyph_stats, 0, sizeof(glyph_stats));
+    glyph_newest = GLYPH_CACHE_NONE;
+    glyph_oldest = GLYPH_CACHE_NONE;
+    glyph_count = 0;
+    glyph_ready = 1;
+}
+
+/**
+ * @brief Get a glyph expanded to big-endian RGB565, expanding it on a miss.
+ *
+ * The returned pointer stays valid until GLYPH_CACHE_SLOTS other glyphs have
+ * been requested.
+ *
+ * @param ch Character to look up.
+ * @param font Font set to use.
+ * @param color Text foreground color.
+ * @param bgcolor Text background color.
+ * @return Glyph pixels, font->width * font->height * 2 bytes, row-major.
+ */
+const uint8_t *glyph_cache_get(char ch, const FontDef *font, uint16_t color, uint16_t bgcolor)
+{
+    uint32_t bucket = 0;
+    uint8_t i = 0;
+    GlyphSlot *s;
+
+    if (!glyph_ready)
+        glyph_cache_reset();
+
+    bucket = glyph_hash(ch, font->data, color, bgcolor);
+    for (i = glyph_buckets[bucket]; i != GLYPH_CACHE_NONE; i = glyph_slots[i].next)
+    {
+        s = &glyph_slots[i];
+        if ((s->ch == ch) && (s->font == font->data) && (s->color == color) && (s->bgcolor == bgcolor))
+        {
+            glyph_stats.hits++;
+            if (glyph_newest != i)
+            {
+                glyph_unlink_lru(i);
+                glyph_push_newest(i);
+            }
+            return glyph_arena[i];
+        }
+    }
+
+    glyph_stats.misses++;
+    if (glyph_count < GLYPH_CACHE_SLOTS)
+    {
+        i = glyph_count++;
+    }
+    else
+    {
+        i = glyph_oldest;
+        glyph_unlink_lru(i);
+        glyph_unlink_bucket(i);
+        glyph_stats.evictions++;
+    }
+
+    s = &glyph_slots[i];
+    s->font = font->data;
+    s->ch = ch;
+    s->color = color;
+    s->bgcolor = bgcolor;
+    s->next = glyph_buckets[bucket];
+    glyph_buckets[bucket] = i;
+    glyph_push_newest(i);
+
+    expand_mask16(&font->data[(ch - 32) * font->height], font->height, font->width, color, bgcolor, glyph_arena[i], sizeof(uint16_t) * font->width);
+    return glyph_arena[i];
+}
+
+/**
+ * @brief Copy the cache hit/miss counters.
+ *
+ * @param stats Destination for the counters.
+ * @return void
+ */
+void glyph_cache_get_stats(GlyphCacheStats *stats)
+{
+    *stats = glyph_stats;
+}
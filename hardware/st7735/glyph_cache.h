@@ -0,0 +1,33 @@
+#ifndef __GLYPH_CACHE_H__
+#define __GLYPH_CACHE_H__
+
+#include <stdint.h>
+#include "fonts.h"
+
+// Number of expanded glyphs kept; each slot fits the largest font (16x26)
+#define GLYPH_CACHE_SLOTS 64
+#define GLYPH_CACHE_SLOT_BYTES (16 * 26 * 2)
+// Hash buckets, power of two
+#define GLYPH_CACHE_BUCKETS 128
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct GlyphCacheStats
+  {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+  } GlyphCacheStats;
+
+  extern const uint8_t *glyph_cache_get(char ch, const FontDef *font, uint16_t color, uint16_t bgcolor);
+  extern void glyph_cache_get_stats(GlyphCacheStats *stats);
+  extern void glyph_cache_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __GLYPH_CACHE_H__
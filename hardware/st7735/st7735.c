@@ -1,5 +1,8 @@
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
@@ -9,299 +12,1737 @@
 #include <linux/i2c-dev.h>
 #include <net/if.h>
 #include <netinet/in.h>
+#include <sys/eventfd.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/sysinfo.h>
 #include <sys/types.h>
 #include <sys/vfs.h>
+#include "drawqueue.h"
+#include "expand.h"
+#include "glyph_cache.h"
 #include "rpiInfo.h"
 #include "st7735.h"
+#include "transport.h"
+#include "widget.h"
 
-int i2cd;
+// Selected with lcd_set_transport() before lcd_begin()
+static const char *lcd_transport_spec = NULL;
+static const Transport *lcd_transport = &transport_i2c;
+
+static BusStats lcd_bus_stats = {0};
+
+// Pending register writes, submitted together as one combined transaction
+static uint8_t i2c_batch_data[I2C_BATCH_MAX][3];
+static uint8_t i2c_batch_count = 0;
+
+// Burst pacing, loaded from LCD_PROFILE_PATH and relaxed on write errors
+static uint16_t i2c_burst_length = BURST_MAX_LENGTH;
+static uint16_t i2c_burst_delay_us = BURST_DELAY_US;
+// Set while lcd_calibrate() is probing, disables the runtime back-off
+static bool lcd_calibrating = false;
+
+// Host-side copy of the panel contents, stored as big-endian RGB565 so that
+// rows can be handed to i2c_burst_transfer() without conversion.
+static uint8_t lcd_framebuffer[ST7735_HEIGHT][ST7735_WIDTH * 2];
+// What the panel currently shows, owned by whichever thread sends frames.
+static uint8_t lcd_shadow[ST7735_HEIGHT][ST7735_WIDTH * 2];
+// The panel contents are unknown, the next frame is sent whole.
+static bool lcd_resend = true;
+// Contiguous staging area for one dirty rectangle.
+static uint8_t lcd_transfer_buffer[ST7735_WIDTH * ST7735_HEIGHT * 2];
+// Expanded monochrome mask for lcd_draw_mask().
+static uint8_t lcd_mask_buffer[ST7735_WIDTH * ST7735_HEIGHT * 2];
+// Static layer of each page: background, header, labels and empty bar slots,
+// rasterized once and copied into the framebuffer when the page is shown.
+static uint8_t lcd_layers[LCD_PAGE_COUNT][ST7735_HEIGHT][ST7735_WIDTH * 2];
+static bool lcd_layer_valid[LCD_PAGE_COUNT] = {false};
+// Header text each layer was rasterized with; a new hostname or address rebuilds it
+static char lcd_layer_header[LCD_PAGE_COUNT][20];
+// Page whose layer is in the framebuffer, -1 for none
+static int8_t lcd_page_current = -1;
+// Bumped whenever a layer is copied into the framebuffer, see widget.c
+static uint32_t lcd_layer_copies = 0;
+
+typedef struct
+{
+    uint16_t x0;
+    uint16_t y0;
+    uint16_t x1;
+    uint16_t y1;
+} lcd_rect;
+
+typedef uint8_t (*lcd_pixels)[ST7735_WIDTH * 2];
+
+// I2C traffic a way of sending a frame generates
+typedef struct
+{
+    uint32_t messages; // I2C messages, each with its own address byte
+    uint32_t bytes;    // payload bytes
+    uint32_t sleep_us; // pacing delays
+} lcd_traffic;
+
+// Bus cost model, loaded from LCD_PROFILE_PATH once lcd_calibrate() has fitted it
+static uint32_t lcd_cost_message_ns = LCD_COST_MESSAGE_NS;
+static uint32_t lcd_cost_byte_ns = LCD_COST_BYTE_NS;
+// Updated by whichever thread sends frames and read by any, so kept under a lock
+static PlanStats lcd_plan_stats = {0};
+static pthread_mutex_t lcd_plan_lock = PTHREAD_MUTEX_INITIALIZER;
+// Traffic of the plans sent since lcd_reset_bus_stats(), for lcd_calibrate()
+static lcd_traffic lcd_planned = {0};
+// Windows of the full-screen, per-tile and merged-rectangle plans
+static lcd_rect lcd_plan_rects[LCD_PLAN_PIXELS][LCD_TILES_X * LCD_TILES_Y];
+
+// A frame handed from the renderer to the transfer thread
+typedef struct
+{
+    uint8_t pixels[ST7735_HEIGHT][ST7735_WIDTH * 2];
+    bool tiles[LCD_TILES_Y][LCD_TILES_X]; // may differ from the panel
+    bool full;                            // panel contents unknown, send everything
+} lcd_frame;
+
+// Triple buffer: the renderer owns lcd_frame_back, the transfer thread
+// lcd_frame_front, and lcd_frame_middle holds the third slot, tagged with
+// LCD_FRAME_FRESH while it carries a frame not yet taken for transfer.
+#define LCD_FRAME_FRESH 0x80
+static lcd_frame lcd_frames[LCD_FRAME_SLOTS];
+static uint8_t lcd_frame_back = 0;
+static _Atomic uint8_t lcd_frame_middle = 1;
+static uint8_t lcd_frame_front = 2;
+// Changes published but possibly not yet taken by the transfer thread
+static bool lcd_unsent_tiles[LCD_TILES_Y][LCD_TILES_X];
+static bool lcd_unsent_full = false;
+static pthread_t lcd_transfer_thread;
+static int lcd_transfer_wake = -1;
+static _Atomic bool lcd_pipeline_running = false;
+
+static void lcd_draw_span(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *data, uint32_t stride);
+static void lcd_batch_address_window(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+static void i2c_burst_chunks(uint8_t *buff, uint32_t length);
+static void i2c_burst_backoff(void);
+
+static lcd_rect lcd_dirty[LCD_DIRTY_MAX];
+static uint8_t lcd_dirty_count = 0;
+
+static uint32_t lcd_rect_area(uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    return (uint32_t)(x1 - x0 + 1) * (y1 - y0 + 1);
+}
 
 /**
- * @brief Set display coordinates.
+ * @brief Record a framebuffer region as needing to be sent to the panel.
  *
- * @param x0 X-coordinate of column origin.
- * @param y0 Y-coordinate of row origin.
- * @param x1 X-coordinate of column origin.
- * @param y1 Y-coordinate of row origin.
+ * Overlapping or touching regions are merged. When the list is full the new
+ * region is folded into whichever entry grows the least.
+ *
+ * @param x X-coordinate of region origin.
+ * @param y Y-coordinate of region origin.
+ * @param w Width of region in pixels.
+ * @param h Height of region in pixels.
  * @return void
  */
-void lcd_set_address_window(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+static void lcd_mark_dirty(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
 {
-    // col address set
-    i2c_write_command(X_COORDINATE_REG, x0 + ST7735_XSTART, x1 + ST7735_XSTART);
-    // row address set
-    i2c_write_command(Y_COORDINATE_REG, y0 + ST7735_YSTART, y1 + ST7735_YSTART);
-    // write to RAM
-    i2c_write_command(CHAR_DATA_REG, 0x00, 0x00);
+    lcd_rect r = {x, y, x + w - 1, y + h - 1};
+    uint8_t i = 0;
+    uint8_t best = 0;
+    uint32_t growth = 0;
+    uint32_t bestGrowth = UINT32_MAX;
+
+    if ((w == 0) || (h == 0))
+        return;
+
+    i = 0;
+    while (i < lcd_dirty_count)
+    {
+        lcd_rect *d = &lcd_dirty[i];
+        if ((r.x0 <= d->x1 + 1) && (d->x0 <= r.x1 + 1) && (r.y0 <= d->y1 + 1) && (d->y0 <= r.y1 + 1))
+        {
+            // absorb the existing entry and rescan, the union may now touch others
+            r.x0 = (d->x0 < r.x0) ? d->x0 : r.x0;
+            r.y0 = (d->y0 < r.y0) ? d->y0 : r.y0;
+            r.x1 = (d->x1 > r.x1) ? d->x1 : r.x1;
+            r.y1 = (d->y1 > r.y1) ? d->y1 : r.y1;
+            lcd_dirty[i] = lcd_dirty[--lcd_dirty_count];
+            i = 0;
+            continue;
+        }
+        i++;
+    }
+
+    if (lcd_dirty_count < LCD_DIRTY_MAX)
+    {
+        lcd_dirty[lcd_dirty_count++] = r;
+        return;
+    }
 
-    i2c_write_command(SYNC_REG, 0x00, 0x01);
+    for (i = 0; i < lcd_dirty_count; i++)
+    {
+        lcd_rect *d = &lcd_dirty[i];
+        growth = lcd_rect_area((d->x0 < r.x0) ? d->x0 : r.x0,
+                               (d->y0 < r.y0) ? d->y0 : r.y0,
+                               (d->x1 > r.x1) ? d->x1 : r.x1,
+                               (d->y1 > r.y1) ? d->y1 : r.y1) -
+                 lcd_rect_area(d->x0, d->y0, d->x1, d->y1);
+        if (growth < bestGrowth)
+        {
+            bestGrowth = growth;
+            best = i;
+        }
+    }
+    r.x0 = (lcd_dirty[best].x0 < r.x0) ? lcd_dirty[best].x0 : r.x0;
+    r.y0 = (lcd_dirty[best].y0 < r.y0) ? lcd_dirty[best].y0 : r.y0;
+    r.x1 = (lcd_dirty[best].x1 > r.x1) ? lcd_dirty[best].x1 : r.x1;
+    r.y1 = (lcd_dirty[best].y1 > r.y1) ? lcd_dirty[best].y1 : r.y1;
+    lcd_dirty[best] = lcd_dirty[--lcd_dirty_count];
+    // the grown entry may now overlap others, so go through the merge pass again
+    lcd_mark_dirty(r.x0, r.y0, r.x1 - r.x0 + 1, r.y1 - r.y0 + 1);
 }
 
 /**
- * @brief Display a single character.
+ * @brief Set a single framebuffer pixel (no clipping).
  *
- * @param x X-coordinate of text origin.
- * @param y Y-coordinate of text origin.
- * @param ch Character to display.
- * @param font Font set to use.
- * @param color Text foreground color.
- * @param bgcolor Text background color.
+ * @param x X-coordinate of pixel.
+ * @param y Y-coordinate of pixel.
+ * @param color Pixel color.
  * @return void
  */
-void lcd_write_char(uint16_t x, uint16_t y, char ch, FontDef font, uint16_t color, uint16_t bgcolor)
+static inline void lcd_put_pixel(uint16_t x, uint16_t y, uint16_t color)
+{
+    lcd_framebuffer[y][x * 2] = color >> 8;
+    lcd_framebuffer[y][x * 2 + 1] = color & 0xFF;
+}
+
+/**
+ * @brief Send one rectangle of a frame and record it as shown on the panel.
+ *
+ * The burst stop is left queued so it shares a transaction with the next
+ * window setup; callers submit the batch when done.
+ *
+ * @param frame Pixels to send from.
+ * @param x0 X-coordinate of first column.
+ * @param y0 Y-coordinate of first row.
+ * @param x1 X-coordinate of last column.
+ * @param y1 Y-coordinate of last row.
+ * @return void
+ */
+static void lcd_send_rect(lcd_pixels frame, uint16_t x0, uint16_t y0, uint16_t x1, uint16_t y1)
+{
+    uint16_t row = 0;
+    uint32_t rowBytes = sizeof(uint16_t) * (x1 - x0 + 1);
+
+    for (row = y0; row <= y1; row++)
+    {
+        memcpy(lcd_transfer_buffer + (row - y0) * rowBytes, &frame[row][x0 * 2], rowBytes);
+        memcpy(&lcd_shadow[row][x0 * 2], &frame[row][x0 * 2], rowBytes);
+    }
+    // window setup, burst start and the previous rectangle's burst stop share one transaction
+    lcd_batch_address_window(x0, y0, x1, y1);
+    i2c_batch_command(BURST_WRITE_REG, 0x00, 0x01);
+    i2c_batch_submit();
+    i2c_burst_chunks(lcd_transfer_buffer, rowBytes * (y1 - y0 + 1));
+    i2c_batch_command(BURST_WRITE_REG, 0x00, 0x00);
+    i2c_batch_command(SYNC_REG, 0x00, 0x01);
+}
+
+/**
+ * @brief Compare one tile of a frame with what the panel shows.
+ *
+ * @param frame Pixels to compare.
+ * @param tx Tile column.
+ * @param ty Tile row.
+ * @return true if any pixel of the tile differs.
+ */
+static bool lcd_tile_changed(lcd_pixels frame, uint16_t tx, uint16_t ty)
+{
+    uint16_t x0 = tx * LCD_TILE_SIZE;
+    uint16_t y0 = ty * LCD_TILE_SIZE;
+    uint16_t x1 = (x0 + LCD_TILE_SIZE > ST7735_WIDTH) ? ST7735_WIDTH : x0 + LCD_TILE_SIZE;
+    uint16_t y1 = (y0 + LCD_TILE_SIZE > ST7735_HEIGHT) ? ST7735_HEIGHT : y0 + LCD_TILE_SIZE;
+    uint16_t row = 0;
+
+    for (row = y0; row < y1; row++)
+    {
+        if (memcmp(&frame[row][x0 * 2], &lcd_shadow[row][x0 * 2], sizeof(uint16_t) * (x1 - x0)) != 0)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Forget what the panel shows, so the next flush resends the whole screen.
+ *
+ * Call after the panel was reset or written behind the driver's back.
+ *
+ * @return void
+ */
+void lcd_invalidate(void)
+{
+    lcd_resend = true;
+}
+
+/**
+ * @brief Turn the dirty rectangles into the tiles to compare, and clear them.
+ *
+ * @param tiles Set for every tile a dirty rectangle touches; others are left as they are.
+ * @return void
+ */
+static void lcd_take_dirty_tiles(bool tiles[LCD_TILES_Y][LCD_TILES_X])
+{
+    uint16_t tx = 0;
+    uint16_t ty = 0;
+    uint8_t i = 0;
+
+    for (i = 0; i < lcd_dirty_count; i++)
+    {
+        lcd_rect *d = &lcd_dirty[i];
+        for (ty = d->y0 / LCD_TILE_SIZE; ty <= d->y1 / LCD_TILE_SIZE; ty++)
+        {
+            for (tx = d->x0 / LCD_TILE_SIZE; tx <= d->x1 / LCD_TILE_SIZE; tx++)
+            {
+                tiles[ty][tx] = true;
+            }
+        }
+    }
+    lcd_dirty_count = 0;
+}
+
+/**
+ * @brief Add the traffic of sending one window to a plan's estimate.
+ *
+ * Mirrors lcd_send_rect(): window setup and burst start share one
+ * transaction with the previous window's burst stop and sync, then the
+ * pixels go out in i2c_burst_length chunks, each followed by the burst delay.
+ *
+ * @param t Traffic estimate to add to.
+ * @param bytes Pixel bytes in the window.
+ * @return void
+ */
+static void lcd_cost_window(lcd_traffic *t, uint32_t bytes)
+{
+    uint32_t chunks = (bytes + i2c_burst_length - 1) / i2c_burst_length;
+
+    t->messages += 7 + chunks;
+    t->bytes += 7 * 3 + bytes;
+    // a combined transaction sleeps once, single writes once per register
+    t->sleep_us += (transport_combined_supported() ? 10 : 7 * 10) + chunks * i2c_burst_delay_us;
+}
+
+/**
+ * @brief Bus time the cost model predicts for some traffic.
+ *
+ * @param t Traffic estimate of a whole frame, see lcd_cost_window().
+ * @return Nanoseconds.
+ */
+static uint64_t lcd_cost_ns(const lcd_traffic *t)
+{
+    return (uint64_t)t->messages * lcd_cost_message_ns + (uint64_t)t->bytes * lcd_cost_byte_ns +
+           (uint64_t)t->sleep_us * 1000;
+}
+
+/**
+ * @brief Merge changed tiles into as few rectangles as possible.
+ *
+ * Runs within a tile row, then extended downwards while the next tile row
+ * has the whole span changed.
+ *
+ * @param changed Changed tiles; cleared on return.
+ * @param rects Destination, room for one rectangle per tile.
+ * @return Number of rectangles.
+ */
+static uint16_t lcd_merge_tiles(bool changed[LCD_TILES_Y][LCD_TILES_X], lcd_rect *rects)
+{
+    uint16_t count = 0;
+    uint16_t tx = 0;
+    uint16_t ty = 0;
+    uint16_t start = 0;
+    uint16_t end = 0;
+    uint16_t bottom = 0;
+    uint16_t i = 0;
+
+    for (ty = 0; ty < LCD_TILES_Y; ty++)
+    {
+        tx = 0;
+        while (tx < LCD_TILES_X)
+        {
+            if (!changed[ty][tx])
+            {
+                tx++;
+                continue;
+            }
+            start = tx;
+            while ((tx < LCD_TILES_X) && changed[ty][tx])
+            {
+                changed[ty][tx++] = false;
+            }
+            end = tx - 1;
+
+            bottom = ty;
+            while (bottom + 1 < LCD_TILES_Y)
+            {
+                for (i = start; (i <= end) && changed[bottom + 1][i]; i++)
+                    ;
+                if (i <= end)
+                    break;
+                bottom++;
+                memset(&changed[bottom][start], false, sizeof(bool) * (end - start + 1));
+            }
+
+            rects[count].x0 = start * LCD_TILE_SIZE;
+            rects[count].y0 = ty * LCD_TILE_SIZE;
+            rects[count].x1 = ((end + 1) * LCD_TILE_SIZE > ST7735_WIDTH) ? ST7735_WIDTH - 1 : (end + 1) * LCD_TILE_SIZE - 1;
+            rects[count].y1 = ((bottom + 1) * LCD_TILE_SIZE > ST7735_HEIGHT) ? ST7735_HEIGHT - 1 : (bottom + 1) * LCD_TILE_SIZE - 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief List the changed tiles as rectangles of their own.
+ *
+ * @param changed Changed tiles.
+ * @param rects Destination, room for one rectangle per tile.
+ * @return Number of rectangles.
+ */
+static uint16_t lcd_list_tiles(bool changed[LCD_TILES_Y][LCD_TILES_X], lcd_rect *rects)
 {
-    uint32_t i, b, j;
+    uint16_t count = 0;
+    uint16_t tx = 0;
+    uint16_t ty = 0;
+
+    for (ty = 0; ty < LCD_TILES_Y; ty++)
+    {
+        for (tx = 0; tx < LCD_TILES_X; tx++)
+        {
+            if (!changed[ty][tx])
+                continue;
+            rects[count].x0 = tx * LCD_TILE_SIZE;
+            rects[count].y0 = ty * LCD_TILE_SIZE;
+            rects[count].x1 = ((tx + 1) * LCD_TILE_SIZE > ST7735_WIDTH) ? ST7735_WIDTH - 1 : (tx + 1) * LCD_TILE_SIZE - 1;
+            rects[count].y1 = ((ty + 1) * LCD_TILE_SIZE > ST7735_HEIGHT) ? ST7735_HEIGHT - 1 : (ty + 1) * LCD_TILE_SIZE - 1;
+            count++;
+        }
+    }
+    return count;
+}
 
-    lcd_set_address_window(x, y, x + font.width - 1, y + font.height - 1);
+/**
+ * @brief Walk the runs of changed pixels on each row of the changed tiles.
+ *
+ * @param frame Pixels to show.
+ * @param changed Changed tiles.
+ * @param t Traffic estimate to add the runs to, or NULL to send them instead.
+ * @return void
+ */
+static void lcd_pixel_runs(lcd_pixels frame, bool changed[LCD_TILES_Y][LCD_TILES_X], lcd_traffic *t)
+{
+    uint16_t x = 0;
+    uint16_t y = 0;
+    uint16_t start = 0;
 
-    for (i = 0; i < font.height; i++)
+    for (y = 0; y < ST7735_HEIGHT; y++)
     {
-        b = font.data[(ch - 32) * font.height + i];
-        for (j = 0; j < font.width; j++)
+        x = 0;
+        while (x < ST7735_WIDTH)
         {
-            if ((b << j) & 0x8000)
+            if (!changed[y / LCD_TILE_SIZE][x / LCD_TILE_SIZE])
+            {
+                x = (x / LCD_TILE_SIZE + 1) * LCD_TILE_SIZE;
+                continue;
+            }
+            if (memcmp(&frame[y][x * 2], &lcd_shadow[y][x * 2], sizeof(uint16_t)) == 0)
             {
-                i2c_write_data(color >> 8, color & 0xFF);
+                x++;
+                continue;
+            }
+            start = x;
+            while ((x < ST7735_WIDTH) && changed[y / LCD_TILE_SIZE][x / LCD_TILE_SIZE] &&
+                   (memcmp(&frame[y][x * 2], &lcd_shadow[y][x * 2], sizeof(uint16_t)) != 0))
+            {
+                x++;
             }
+            if (t != NULL)
+                lcd_cost_window(t, sizeof(uint16_t) * (x - start));
             else
+                lcd_send_rect(frame, start, y, x - 1, y);
+        }
+    }
+}
+
+/**
+ * @brief Read the bus clock the plans are measured against.
+ *
+ * Transports that only model the bus (mock) keep their own clock, which
+ * advances by the time the traffic would take; the others take real time.
+ *
+ * @return Time in microseconds from an arbitrary origin.
+ */
+static uint64_t lcd_bus_clock_us(void)
+{
+    struct timespec now;
+
+    if (lcd_transport->clock_us != NULL)
+        return lcd_transport->clock_us();
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * @brief Send the changes of a frame to the panel, using the cheapest plan.
+ *
+ * The candidate tiles are compared with the shadow copy of the panel. The
+ * changed tiles can then go out as the whole screen, one window per tile,
+ * merged rectangles or one window per run of changed pixels; every window
+ * costs a setup transaction and its burst chunks. The bus cost model prices
+ * each plan and the cheapest is sent; its prediction and the measured time
+ * are added to the plan statistics.
+ *
+ * @param frame Pixels to show.
+ * @param tiles Tiles that may differ from the panel; cleared on return.
+ * @param full Send the whole frame, the panel contents are unknown.
+ * @return void
+ */
+static void lcd_send_frame(lcd_pixels frame, bool tiles[LCD_TILES_Y][LCD_TILES_X], bool full)
+{
+    bool changed[LCD_TILES_Y][LCD_TILES_X] = {{false}};
+    bool merged[LCD_TILES_Y][LCD_TILES_X];
+    lcd_traffic traffic[LCD_PLAN_COUNT];
+    uint64_t cost[LCD_PLAN_COUNT] = {0};
+    uint16_t rects[LCD_PLAN_COUNT] = {0};
+    lcd_rect *r;
+    uint64_t start = 0;
+    bool any = false;
+    uint16_t tx = 0;
+    uint16_t ty = 0;
+    uint16_t i = 0;
+    uint8_t plan = LCD_PLAN_FULL;
+
+    memset(traffic, 0, sizeof(traffic));
+    if (!full)
+    {
+        for (ty = 0; ty < LCD_TILES_Y; ty++)
+        {
+            for (tx = 0; tx < LCD_TILES_X; tx++)
             {
-                i2c_write_data(bgcolor >> 8, bgcolor & 0xFF);
+                changed[ty][tx] = tiles[ty][tx] && lcd_tile_changed(frame, tx, ty);
+                any = any || changed[ty][tx];
             }
         }
     }
+    memset(tiles, false, sizeof(bool) * LCD_TILES_Y * LCD_TILES_X);
+    if (!full && !any)
+        return;
+
+    lcd_plan_rects[LCD_PLAN_FULL][0] = (lcd_rect){0, 0, ST7735_WIDTH - 1, ST7735_HEIGHT - 1};
+    rects[LCD_PLAN_FULL] = 1;
+    if (!full)
+    {
+        rects[LCD_PLAN_TILES] = lcd_list_tiles(changed, lcd_plan_rects[LCD_PLAN_TILES]);
+        memcpy(merged, changed, sizeof(changed));
+        rects[LCD_PLAN_RECTS] = lcd_merge_tiles(merged, lcd_plan_rects[LCD_PLAN_RECTS]);
+        lcd_pixel_runs(frame, changed, &traffic[LCD_PLAN_PIXELS]);
+    }
+    for (plan = LCD_PLAN_FULL; plan < LCD_PLAN_PIXELS; plan++)
+    {
+        for (i = 0; i < rects[plan]; i++)
+        {
+            r = &lcd_plan_rects[plan][i];
+            lcd_cost_window(&traffic[plan], sizeof(uint16_t) * (r->x1 - r->x0 + 1) * (r->y1 - r->y0 + 1));
+        }
+        cost[plan] = lcd_cost_ns(&traffic[plan]);
+    }
+    cost[LCD_PLAN_PIXELS] = lcd_cost_ns(&traffic[LCD_PLAN_PIXELS]);
+
+    // ties go to merged rectangles, the plan used before there was a choice
+    plan = LCD_PLAN_FULL;
+    if (!full)
+    {
+        plan = LCD_PLAN_RECTS;
+        for (i = 0; i < LCD_PLAN_COUNT; i++)
+        {
+            if (cost[i] < cost[plan])
+                plan = i;
+        }
+    }
+    // the last window's burst stop and sync go out in one more transaction
+    traffic[plan].sleep_us += transport_combined_supported() ? 10 : 0;
+    cost[plan] = lcd_cost_ns(&traffic[plan]);
+
+    start = lcd_bus_clock_us();
+    if (plan == LCD_PLAN_PIXELS)
+    {
+        lcd_pixel_runs(frame, changed, NULL);
+    }
+    else
+    {
+        for (i = 0; i < rects[plan]; i++)
+        {
+            r = &lcd_plan_rects[plan][i];
+            lcd_send_rect(frame, r->x0, r->y0, r->x1, r->y1);
+        }
+    }
+    i2c_batch_submit();
+
+    pthread_mutex_lock(&lcd_plan_lock);
+    lcd_plan_stats.frames[plan]++;
+    lcd_plan_stats.predicted_us[plan] += cost[plan] / 1000;
+    lcd_plan_stats.actual_us[plan] += lcd_bus_clock_us() - start;
+    pthread_mutex_unlock(&lcd_plan_lock);
+    lcd_planned.messages += traffic[plan].messages;
+    lcd_planned.bytes += traffic[plan].bytes;
+    lcd_planned.sleep_us += traffic[plan].sleep_us;
 }
 
-void lcd_write_ch(uint16_t x, uint16_t y, char ch, FontType font, uint16_t color, uint16_t bgcolor)
+/**
+ * @brief Transfer thread: send the newest published frame whenever woken.
+ *
+ * @param arg Unused.
+ * @return NULL
+ */
+static void *lcd_transfer_main(void *arg)
 {
-    switch (font)
+    uint64_t wakeups = 0;
+    uint8_t middle = 0;
+    bool running = true;
+
+    while (running)
     {
-    case FontType_7x10:
-        lcd_write_char(x, y, ch, Font_7x10, color, bgcolor);
-        break;
-    case FontType_8x16:
-        lcd_write_char(x, y, ch, Font_8x16, color, bgcolor);
-        break;
-    case FontType_11x18:
-        lcd_write_char(x, y, ch, Font_11x18, color, bgcolor);
-        break;
-    case FontType_16x26:
-        lcd_write_char(x, y, ch, Font_16x26, color, bgcolor);
-        break;
+        if ((read(lcd_transfer_wake, &wakeups, sizeof(wakeups)) < 0) && (errno == EINTR))
+            continue;
+        // stop only after sending what was published before lcd_pipeline_stop()
+        running = atomic_load_explicit(&lcd_pipeline_running, memory_order_acquire);
+
+        middle = atomic_load_explicit(&lcd_frame_middle, memory_order_relaxed);
+        if (!(middle & LCD_FRAME_FRESH))
+            continue;
+        // hand the sent frame back and take the newest; clearing FRESH tells the
+        // renderer this one was consumed
+        middle = atomic_exchange_explicit(&lcd_frame_middle, lcd_frame_front, memory_order_acq_rel);
+        lcd_frame_front = middle & ~LCD_FRAME_FRESH;
+        lcd_send_frame(lcd_frames[lcd_frame_front].pixels, lcd_frames[lcd_frame_front].tiles, lcd_frames[lcd_frame_front].full);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Publish the framebuffer to the transfer thread without waiting for the bus.
+ *
+ * @return void
+ */
+static void lcd_publish(void)
+{
+    lcd_frame *back = &lcd_frames[lcd_frame_back];
+    bool own[LCD_TILES_Y][LCD_TILES_X] = {{false}};
+    bool merged[LCD_TILES_Y][LCD_TILES_X];
+    bool ownFull = lcd_resend;
+    bool mergedFull = ownFull || lcd_unsent_full;
+    uint64_t one = 1;
+    uint8_t old = 0;
+    uint16_t tx = 0;
+    uint16_t ty = 0;
+
+    lcd_resend = false;
+    lcd_take_dirty_tiles(own);
+    for (ty = 0; ty < LCD_TILES_Y; ty++)
+    {
+        for (tx = 0; tx < LCD_TILES_X; tx++)
+        {
+            merged[ty][tx] = own[ty][tx] || lcd_unsent_tiles[ty][tx];
+        }
+    }
+
+    memcpy(back->pixels, lcd_framebuffer, sizeof(lcd_framebuffer));
+    memcpy(back->tiles, merged, sizeof(merged));
+    back->full = mergedFull;
+
+    old = atomic_exchange_explicit(&lcd_frame_middle, lcd_frame_back | LCD_FRAME_FRESH, memory_order_acq_rel);
+    lcd_frame_back = old & ~LCD_FRAME_FRESH;
+    if (old & LCD_FRAME_FRESH)
+    {
+        // the replaced frame was never sent, so its changes stay outstanding
+        memcpy(lcd_unsent_tiles, merged, sizeof(merged));
+        lcd_unsent_full = mergedFull;
+    }
+    else
+    {
+        // the transfer thread took the previous frame, only this one's changes are outstanding
+        memcpy(lcd_unsent_tiles, own, sizeof(own));
+        lcd_unsent_full = ownFull;
+    }
+
+    if (write(lcd_transfer_wake, &one, sizeof(one)) != sizeof(one))
+        fprintf(stderr, "st7735: Unable to wake transfer thread\n");
+}
+
+/**
+ * @brief Send framebuffer changes to the panel.
+ *
+ * Commands other threads posted to the draw queue are drawn first. Without
+ * the pipeline this blocks until the changes are on the panel. With
+ * lcd_pipeline_start() it only hands a copy of the framebuffer to the
+ * transfer thread, and drawing can continue while the bus is busy.
+ *
+ * @return void
+ */
+void lcd_flush(void)
+{
+    bool tiles[LCD_TILES_Y][LCD_TILES_X] = {{false}};
+    bool full = false;
+
+    draw_queue_apply();
+    full = lcd_resend;
+    if (atomic_load_explicit(&lcd_pipeline_running, memory_order_relaxed))
+    {
+        lcd_publish();
+        return;
+    }
+
+    lcd_resend = false;
+    lcd_take_dirty_tiles(tiles);
+    lcd_send_frame(lcd_framebuffer, tiles, full);
+}
+
+/**
+ * @brief Start sending frames from a separate transfer thread.
+ *
+ * The transfer thread owns the bus from here on: until lcd_pipeline_stop(),
+ * only draw and call lcd_flush(), which returns without waiting for the
+ * transfer. Frames are exchanged through three buffers: the renderer fills
+ * one, one waits, and one is being sent; a frame published while another is
+ * still waiting replaces it, so the panel catches up with the newest frame
+ * after at most one transfer.
+ *
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lcd_pipeline_start(void)
+{
+    if (atomic_load_explicit(&lcd_pipeline_running, memory_order_relaxed))
+        return 0;
+
+    lcd_transfer_wake = eventfd(0, EFD_CLOEXEC);
+    if (lcd_transfer_wake < 0)
+    {
+        fprintf(stderr, "st7735: Unable to create transfer eventfd\n");
+        return 1;
+    }
+    i2c_batch_submit();
+    lcd_frame_back = 0;
+    atomic_store_explicit(&lcd_frame_middle, 1, memory_order_relaxed);
+    lcd_frame_front = 2;
+    memset(lcd_unsent_tiles, false, sizeof(lcd_unsent_tiles));
+    lcd_unsent_full = false;
+
+    atomic_store_explicit(&lcd_pipeline_running, true, memory_order_release);
+    if (pthread_create(&lcd_transfer_thread, NULL, lcd_transfer_main, NULL) != 0)
+    {
+        atomic_store_explicit(&lcd_pipeline_running, false, memory_order_relaxed);
+        close(lcd_transfer_wake);
+        lcd_transfer_wake = -1;
+        fprintf(stderr, "st7735: Unable to start transfer thread\n");
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Send the last published frame and stop the transfer thread.
+ *
+ * @return void
+ */
+void lcd_pipeline_stop(void)
+{
+    uint64_t one = 1;
+
+    if (!atomic_load_explicit(&lcd_pipeline_running, memory_order_relaxed))
+        return;
+
+    atomic_store_explicit(&lcd_pipeline_running, false, memory_order_release);
+    if (write(lcd_transfer_wake, &one, sizeof(one)) != sizeof(one))
+        fprintf(stderr, "st7735: Unable to wake transfer thread\n");
+    pthread_join(lcd_transfer_thread, NULL);
+    close(lcd_transfer_wake);
+    lcd_transfer_wake = -1;
+}
+
+/**
+ * @brief Set display coordinates.
+ *
+ * @param x0 X-coordinate of column origin.
+ * @param y0 Y-coordinate of row origin.
+ * @param x1 X-coordinate of column origin.
+ * @param y1 Y-coordinate of row origin.
+ * @return void
+ */
+void lcd_set_address_window(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+    lcd_batch_address_window(x0, y0, x1, y1);
+    i2c_batch_submit();
+}
+
+/**
+ * @brief Queue the display coordinate commands without submitting them.
+ *
+ * @param x0 X-coordinate of column origin.
+ * @param y0 Y-coordinate of row origin.
+ * @param x1 X-coordinate of column origin.
+ * @param y1 Y-coordinate of row origin.
+ * @return void
+ */
+static void lcd_batch_address_window(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+    // col address set
+    i2c_batch_command(X_COORDINATE_REG, x0 + ST7735_XSTART, x1 + ST7735_XSTART);
+    // row address set
+    i2c_batch_command(Y_COORDINATE_REG, y0 + ST7735_YSTART, y1 + ST7735_YSTART);
+    // write to RAM
+    i2c_batch_command(CHAR_DATA_REG, 0x00, 0x00);
+
+    i2c_batch_command(SYNC_REG, 0x00, 0x01);
+}
+
+/**
+ * @brief Display a single character.
+ *
+ * @param x X-coordinate of text origin.
+ * @param y Y-coordinate of text origin.
+ * @param ch Character to display.
+ * @param font Font set to use.
+ * @param color Text foreground color.
+ * @param bgcolor Text background color.
+ * @return void
+ */
+void lcd_write_char(uint16_t x, uint16_t y, char ch, FontDef font, uint16_t color, uint16_t bgcolor)
+{
+    // clipping
+    if ((x + font.width > ST7735_WIDTH) || (y + font.height > ST7735_HEIGHT))
+        return;
+
+    // glyphs come pre-expanded to big-endian RGB565 so the whole glyph is one window
+    lcd_draw_span(x, y, font.width, font.height, glyph_cache_get(ch, &font, color, bgcolor), sizeof(uint16_t) * font.width);
+}
+
+void lcd_write_ch(uint16_t x, uint16_t y, char ch, FontType font, uint16_t color, uint16_t bgcolor)
+{
+    switch (font)
+    {
+    case FontType_7x10:
+        lcd_write_char(x, y, ch, Font_7x10, color, bgcolor);
+        break;
+    case FontType_8x16:
+        lcd_write_char(x, y, ch, Font_8x16, color, bgcolor);
+        break;
+    case FontType_11x18:
+        lcd_write_char(x, y, ch, Font_11x18, color, bgcolor);
+        break;
+    case FontType_16x26:
+        lcd_write_char(x, y, ch, Font_16x26, color, bgcolor);
+        break;
+    }
+}
+
+/**
+ * @brief Display a text string.
+ *
+ * @param x X-coordinate of text origin.
+ * @param y Y-coordinate of text origin.
+ * @param str String to display.
+ * @param font Font set to use.
+ * @param color Text foreground color.
+ * @param bgcolor Text background color.
+ * @return void
+ */
+void lcd_write_string(uint16_t x, uint16_t y, char *str, FontDef font, uint16_t color, uint16_t bgcolor)
+{
+    // one text line rasterized side by side, sent as a single window
+    uint8_t span[LCD_SPAN_MAX_BYTES];
+    uint32_t stride = sizeof(uint16_t) * ST7735_WIDTH;
+    uint16_t runX = x;
+    uint16_t runWidth = 0;
+    uint32_t glyphStride = sizeof(uint16_t) * font.width;
+    const uint8_t *glyph;
+    uint16_t row = 0;
+
+    while (*str)
+    {
+        if (x + font.width >= ST7735_WIDTH)
+        {
+            if (runWidth > 0)
+            {
+                lcd_draw_span(runX, y, runWidth, font.height, span, stride);
+                runWidth = 0;
+            }
+            x = 0;
+            runX = 0;
+            y += font.height;
+            if (y + font.height >= ST7735_HEIGHT)
+            {
+                break;
+            }
+
+            if (*str == ' ')
+            {
+                // skip spaces in the beginning of the new line
+                str++;
+                continue;
+            }
+        }
+
+        glyph = glyph_cache_get(*str, &font, color, bgcolor);
+        for (row = 0; row < font.height; row++)
+        {
+            memcpy(span + row * stride + sizeof(uint16_t) * runWidth, glyph + row * glyphStride, glyphStride);
+        }
+        runWidth += font.width;
+        x += font.width;
+        str++;
+    }
+
+    if (runWidth > 0)
+    {
+        lcd_draw_span(runX, y, runWidth, font.height, span, stride);
+    }
+}
+
+void lcd_write_str(uint16_t x, uint16_t y, char *str, FontType font, uint16_t color, uint16_t bgcolor)
+{
+    switch (font)
+    {
+    case FontType_7x10:
+        lcd_write_string(x, y, str, Font_7x10, color, bgcolor);
+        break;
+    case FontType_8x16:
+        lcd_write_string(x, y, str, Font_8x16, color, bgcolor);
+        break;
+    case FontType_11x18:
+        lcd_write_string(x, y, str, Font_11x18, color, bgcolor);
+        break;
+    case FontType_16x26:
+        lcd_write_string(x, y, str, Font_16x26, color, bgcolor);
+        break;
+    }
+}
+
+/**
+ * @brief Flood fill rectangle with selected color.
+ *
+ * @param x X-coordinate of rectangle origin.
+ * @param y Y-coordinate of rectangle origin.
+ * @param w Width of rectangle in pixels.
+ * @param h Height of rectangle in pixels.
+ * @param color Color to fill with.
+ * @return void
+ */
+void lcd_fill_rectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+    uint16_t count = 0;
+    uint16_t row = 0;
+    // clipping
+    if ((x >= ST7735_WIDTH) || (y >= ST7735_HEIGHT))
+        return;
+    if ((x + w - 1) >= ST7735_WIDTH)
+        w = ST7735_WIDTH - x;
+    if ((y + h - 1) >= ST7735_HEIGHT)
+        h = ST7735_HEIGHT - y;
+
+    for (count = 0; count < w; count++)
+    {
+        lcd_put_pixel(x + count, y, color);
+    }
+    for (row = y + 1; row < y + h; row++)
+    {
+        memcpy(&lcd_framebuffer[row][x * 2], &lcd_framebuffer[y][x * 2], sizeof(uint16_t) * w);
+    }
+    lcd_mark_dirty(x, y, w, h);
+}
+
+/**
+ * @brief Flood fill screen with selected color.
+ *
+ * @param color Color to fill with.
+ * @return void
+ */
+void lcd_fill_screen(uint16_t color)
+{
+    lcd_fill_rectangle(0, 0, ST7735_WIDTH, ST7735_HEIGHT, color);
+}
+
+/**
+ * @brief Fill a row of equally spaced rectangles with one color.
+ *
+ * Draws like lcd_fill_rectangle() once per segment, but records a single
+ * dirty region spanning them all; the gaps are left untouched.
+ *
+ * @param x X-coordinate of the first segment.
+ * @param y Y-coordinate of the segments.
+ * @param count Number of segments.
+ * @param w Width of each segment in pixels.
+ * @param pitch Distance between segment origins in pixels.
+ * @param h Height of the segments in pixels.
+ * @param color Color to fill with.
+ * @return void
+ */
+void lcd_fill_segments(uint16_t x, uint16_t y, uint8_t count, uint16_t w, uint16_t pitch, uint16_t h, uint16_t color)
+{
+    uint16_t span = 0;
+    uint16_t segX = 0;
+    uint16_t segW = 0;
+    uint16_t col = 0;
+    uint16_t row = 0;
+    uint8_t i = 0;
+
+    if ((count == 0) || (x >= ST7735_WIDTH) || (y >= ST7735_HEIGHT))
+        return;
+    if ((y + h - 1) >= ST7735_HEIGHT)
+        h = ST7735_HEIGHT - y;
+
+    for (i = 0; i < count; i++)
+    {
+        segX = x + i * pitch;
+        if (segX >= ST7735_WIDTH)
+            break;
+        segW = ((segX + w - 1) >= ST7735_WIDTH) ? ST7735_WIDTH - segX : w;
+        for (col = 0; col < segW; col++)
+        {
+            lcd_put_pixel(segX + col, y, color);
+        }
+        for (row = y + 1; row < y + h; row++)
+        {
+            memcpy(&lcd_framebuffer[row][segX * 2], &lcd_framebuffer[y][segX * 2], sizeof(uint16_t) * segW);
+        }
+        span = segX + segW - x;
+    }
+    lcd_mark_dirty(x, y, span, h);
+}
+
+/**
+ * @brief Copy a big-endian RGB565 block with arbitrary row stride into the framebuffer.
+ *
+ * Blocks that do not fit vertically are dropped, matching lcd_write_char().
+ *
+ * @param x X-coordinate of block origin.
+ * @param y Y-coordinate of block origin.
+ * @param w Width of block in pixels.
+ * @param h Height of block in pixels.
+ * @param data Block pixels.
+ * @param stride Distance in bytes between rows of data.
+ * @return void
+ */
+static void lcd_draw_span(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *data, uint32_t stride)
+{
+    uint16_t row = 0;
+    // clipping
+    if ((x >= ST7735_WIDTH) || (y + h > ST7735_HEIGHT))
+        return;
+    if ((x + w - 1) >= ST7735_WIDTH)
+        w = ST7735_WIDTH - x;
+
+    for (row = 0; row < h; row++)
+    {
+        memcpy(&lcd_framebuffer[y + row][x * 2], data + row * stride, sizeof(uint16_t) * w);
+    }
+    lcd_mark_dirty(x, y, w, h);
+}
+
+/**
+ * @brief Copy a big-endian RGB565 image into the framebuffer.
+ *
+ * @param x X-coordinate of image origin.
+ * @param y Y-coordinate of image origin.
+ * @param w Width of image in pixels.
+ * @param h Height of image in pixels.
+ * @param data Image pixels, w * h * 2 bytes, row-major.
+ * @return void
+ */
+void lcd_draw_image(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    // clipping
+    if (y >= ST7735_HEIGHT)
+        return;
+    if ((y + h - 1) >= ST7735_HEIGHT)
+        h = ST7735_HEIGHT - y;
+    lcd_draw_span(x, y, w, h, data, sizeof(uint16_t) * w);
+}
+
+/**
+ * @brief Draw a monochrome bitmap (icon or mask) in two colors.
+ *
+ * @param x X-coordinate of bitmap origin.
+ * @param y Y-coordinate of bitmap origin.
+ * @param w Width of bitmap in pixels.
+ * @param h Height of bitmap in pixels.
+ * @param mask 1bpp rows, most significant bit leftmost, (w + 7) / 8 bytes per row.
+ * @param color Color for set bits.
+ * @param bgcolor Color for clear bits.
+ * @return void
+ */
+void lcd_draw_mask(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *mask, uint16_t color, uint16_t bgcolor)
+{
+    uint16_t rowBytes = (w + 7) / 8;
+    uint16_t row = 0;
+    uint16_t col = 0;
+    uint16_t bits = 0;
+    const uint8_t *src;
+
+    // clipping
+    if ((x >= ST7735_WIDTH) || (y >= ST7735_HEIGHT))
+        return;
+    if ((x + w - 1) >= ST7735_WIDTH)
+        w = ST7735_WIDTH - x;
+    if ((y + h - 1) >= ST7735_HEIGHT)
+        h = ST7735_HEIGHT - y;
+
+    for (row = 0; row < h; row++)
+    {
+        for (col = 0; col < w; col += 16)
+        {
+            src = mask + row * rowBytes + col / 8;
+            bits = (src[0] << 8) | ((col / 8 + 1 < rowBytes) ? src[1] : 0);
+            expand_mask16(&bits, 1, (w - col > 16) ? 16 : w - col, color, bgcolor,
+                          lcd_mask_buffer + (row * w + col) * sizeof(uint16_t), 0);
+        }
+    }
+    lcd_draw_span(x, y, w, h, lcd_mask_buffer, sizeof(uint16_t) * w);
+}
+
+/**
+ * @brief Select the display transport used by the next lcd_begin().
+ *
+ * @param spec Transport spec ("i2c[:device]", "mock", "record[:file]" or "emu[:file.ppm]"), NULL for TRANSPORT_DEFAULT.
+ * @return void
+ */
+void lcd_set_transport(const char *spec)
+{
+    lcd_transport_spec = spec;
+}
+
+uint8_t lcd_begin(void)
+{
+    lcd_transport = transport_find(lcd_transport_spec);
+    if (lcd_transport == NULL)
+    {
+        fprintf(stderr, "Unknown display transport %s\n", lcd_transport_spec);
+        return 1;
+    }
+    if (transport_open(lcd_transport, lcd_transport_spec) < 0)
+    {
+        fprintf(stderr, "Display transport %s failed to initialize\n", (lcd_transport_spec != NULL) ? lcd_transport_spec : TRANSPORT_DEFAULT);
+        return 1;
+    }
+    lcd_invalidate();
+    lcd_load_profile(LCD_PROFILE_PATH);
+    return 0;
+}
+
+/**
+ * @brief Release the display transport.
+ *
+ * @return void
+ */
+void lcd_end(void)
+{
+    lcd_pipeline_stop();
+    i2c_batch_submit();
+    lcd_transport->close();
+}
+
+/**
+ * @brief Copy the bus activity counters.
+ *
+ * @param stats Destination for the counters.
+ * @return void
+ */
+void lcd_get_bus_stats(BusStats *stats)
+{
+    *stats = lcd_bus_stats;
+}
+
+/**
+ * @brief Zero the bus activity counters and the plan statistics.
+ *
+ * @return void
+ */
+void lcd_reset_bus_stats(void)
+{
+    memset(&lcd_bus_stats, 0, sizeof(lcd_bus_stats));
+    pthread_mutex_lock(&lcd_plan_lock);
+    memset(&lcd_plan_stats, 0, sizeof(lcd_plan_stats));
+    pthread_mutex_unlock(&lcd_plan_lock);
+    memset(&lcd_planned, 0, sizeof(lcd_planned));
+}
+
+/**
+ * @brief Copy the per-plan frame counts and bus times.
+ *
+ * Safe to call while the transfer thread is sending; the copy is consistent.
+ *
+ * @param stats Destination for the statistics.
+ * @return void
+ */
+void lcd_get_plan_stats(PlanStats *stats)
+{
+    pthread_mutex_lock(&lcd_plan_lock);
+    *stats = lcd_plan_stats;
+    pthread_mutex_unlock(&lcd_plan_lock);
+}
+
+void i2c_write_data(uint8_t high, uint8_t low)
+{
+    uint8_t msg[3] = {WRITE_DATA_REG, high, low};
+    if (lcd_transport->write(msg, 3) != 3)
+        lcd_bus_stats.errors++;
+    lcd_transport->delay(10);
+    lcd_bus_stats.syscalls++;
+    lcd_bus_stats.bytes += 3;
+    lcd_bus_stats.sleep_us += 10;
+}
+
+void i2c_write_command(uint8_t command, uint8_t high, uint8_t low)
+{
+    uint8_t msg[3] = {command, high, low};
+    if (lcd_transport->write(msg, 3) != 3)
+        lcd_bus_stats.errors++;
+    lcd_transport->delay(10);
+    lcd_bus_stats.syscalls++;
+    lcd_bus_stats.bytes += 3;
+    lcd_bus_stats.sleep_us += 10;
+}
+
+/**
+ * @brief Queue a register write for the next batched transaction.
+ *
+ * The batch is submitted automatically when it fills up.
+ *
+ * @param command Register address.
+ * @param high Register value high byte.
+ * @param low Register value low byte.
+ * @return void
+ */
+void i2c_batch_command(uint8_t command, uint8_t high, uint8_t low)
+{
+    uint8_t *msg = i2c_batch_data[i2c_batch_count];
+
+    msg[0] = command;
+    msg[1] = high;
+    msg[2] = low;
+    if (++i2c_batch_count == I2C_BATCH_MAX)
+    {
+        i2c_batch_submit();
+    }
+}
+
+/**
+ * @brief Send all queued register writes.
+ *
+ * Uses a single combined transaction (I2C_RDWR on i2c-dev) when the
+ * transport supports it, otherwise falls back to one write() per register.
+ *
+ * @return void
+ */
+void i2c_batch_submit(void)
+{
+    uint8_t i = 0;
+
+    if (i2c_batch_count == 0)
+        return;
+
+    if (transport_combined_supported())
+    {
+        if (lcd_transport->write_commands(&i2c_batch_data[0][0], i2c_batch_count) == 0)
+        {
+            lcd_transport->delay(10);
+            lcd_bus_stats.syscalls++;
+            lcd_bus_stats.bytes += 3 * i2c_batch_count;
+            lcd_bus_stats.sleep_us += 10;
+            i2c_batch_count = 0;
+            return;
+        }
+        // the transport clears its flag when the adapter turns out not to combine
+        if (!transport_combined_supported())
+        {
+            fprintf(stderr, "st7735: Combined transfers not supported, using single writes\n");
+        }
+        else
+        {
+            lcd_bus_stats.errors++;
+        }
+    }
+
+    for (i = 0; i < i2c_batch_count; i++)
+    {
+        i2c_write_command(i2c_batch_data[i][0], i2c_batch_data[i][1], i2c_batch_data[i][2]);
+    }
+    i2c_batch_count = 0;
+}
+
+/**
+ * @brief Stream pixel data in BURST_MAX_LENGTH chunks (burst mode must be active).
+ *
+ * @param buff Pixel data.
+ * @param length Length of pixel data in bytes.
+ * @return void
+ */
+static void i2c_burst_chunks(uint8_t *buff, uint32_t length)
+{
+    uint32_t count = 0;
+    uint32_t chunk = 0;
+    uint8_t retries = 0;
+    while (length > count)
+    {
+        chunk = ((length - count) > i2c_burst_length) ? i2c_burst_length : (length - count);
+        if (lcd_transport->write(buff + count, chunk) != (int)chunk)
+        {
+            lcd_bus_stats.errors++;
+            if (!lcd_calibrating && (retries++ < BURST_RETRY_MAX))
+            {
+                // slow down and resend the same chunk
+                i2c_burst_backoff();
+                lcd_transport->delay(i2c_burst_delay_us);
+                lcd_bus_stats.syscalls++;
+                lcd_bus_stats.sleep_us += i2c_burst_delay_us;
+                continue;
+            }
+        }
+        retries = 0;
+        lcd_bus_stats.bytes += chunk;
+        count += chunk;
+        lcd_transport->delay(i2c_burst_delay_us);
+        lcd_bus_stats.syscalls++;
+        lcd_bus_stats.sleep_us += i2c_burst_delay_us;
+    }
+}
+
+/**
+ * @brief Relax the burst settings after a failed transfer.
+ *
+ * Doubles the inter-chunk delay up to BURST_DELAY_MAX, then halves the chunk
+ * length down to BURST_MIN_LENGTH.
+ *
+ * @return void
+ */
+static void i2c_burst_backoff(void)
+{
+    if (i2c_burst_delay_us < BURST_DELAY_MAX)
+    {
+        i2c_burst_delay_us = (i2c_burst_delay_us < 50) ? 50 : i2c_burst_delay_us * 2;
+        if (i2c_burst_delay_us > BURST_DELAY_MAX)
+            i2c_burst_delay_us = BURST_DELAY_MAX;
+    }
+    else if (i2c_burst_length > BURST_MIN_LENGTH)
+    {
+        i2c_burst_length /= 2;
+        if (i2c_burst_length < BURST_MIN_LENGTH)
+            i2c_burst_length = BURST_MIN_LENGTH;
+    }
+    else
+    {
+        return;
+    }
+    fprintf(stderr, "st7735: I2C write failed, backing off to %u byte chunks / %u us\n", i2c_burst_length, i2c_burst_delay_us);
+}
+
+/**
+ * @brief Load burst settings and the bus cost model saved by lcd_calibrate().
+ *
+ * Missing files and unknown keys are ignored; out of range values are clamped.
+ *
+ * @param path Profile file to read.
+ * @return 0 if the profile was loaded, 1 otherwise.
+ */
+uint8_t lcd_load_profile(const char *path)
+{
+    FILE *fd;
+    char line[64] = {0};
+    unsigned int value = 0;
+
+    fd = fopen(path, "r");
+    if (fd == NULL)
+    {
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), fd))
+    {
+        if (sscanf(line, "burst_length=%u", &value) == 1)
+        {
+            i2c_burst_length = (value < BURST_MIN_LENGTH) ? BURST_MIN_LENGTH : (value > BURST_LENGTH_MAX) ? BURST_LENGTH_MAX : value;
+        }
+        else if (sscanf(line, "burst_delay_us=%u", &value) == 1)
+        {
+            i2c_burst_delay_us = (value > BURST_DELAY_MAX) ? BURST_DELAY_MAX : value;
+        }
+        else if (sscanf(line, "message_ns=%u", &value) == 1)
+        {
+            lcd_cost_message_ns = value;
+        }
+        else if (sscanf(line, "byte_ns=%u", &value) == 1)
+        {
+            lcd_cost_byte_ns = value;
+        }
+    }
+
+    fclose(fd);
+    return 0;
+}
+
+/**
+ * @brief Save the current burst settings and bus cost model.
+ *
+ * @param path Profile file to write.
+ * @return 0 on success, 1 on failure.
+ */
+uint8_t lcd_save_profile(const char *path)
+{
+    FILE *fd;
+
+    fd = fopen(path, "w");
+    if (fd == NULL)
+    {
+        fprintf(stderr, "st7735: Unable to write profile %s\n", path);
+        return 1;
+    }
+
+    fprintf(fd, "burst_length=%u\n", i2c_burst_length);
+    fprintf(fd, "burst_delay_us=%u\n", i2c_burst_delay_us);
+    fprintf(fd, "message_ns=%u\n", lcd_cost_message_ns);
+    fprintf(fd, "byte_ns=%u\n", lcd_cost_byte_ns);
+
+    fclose(fd);
+    return 0;
+}
+
+/**
+ * @brief Send a full-screen verification pattern LCD_CALIBRATE_PASSES times.
+ *
+ * @param elapsed Set to the average time per pass in microseconds.
+ * @return true if every transfer was accepted by the bridge.
+ */
+static bool lcd_calibrate_pass(uint32_t *elapsed)
+{
+    uint64_t start = 0;
+    uint16_t x = 0;
+    uint16_t y = 0;
+    uint8_t pass = 0;
+
+    lcd_reset_bus_stats();
+    start = lcd_bus_clock_us();
+    for (pass = 0; pass < LCD_CALIBRATE_PASSES; pass++)
+    {
+        // checkerboard of alternating bit patterns, shifted every pass
+        for (y = 0; y < ST7735_HEIGHT; y++)
+        {
+            for (x = 0; x < ST7735_WIDTH; x++)
+            {
+                lcd_put_pixel(x, y, (((x >> 3) + (y >> 3) + pass) & 1) ? 0xA5A5 : 0x5A5A);
+            }
+        }
+        lcd_invalidate();
+        lcd_flush();
     }
+    *elapsed = (lcd_bus_clock_us() - start) / LCD_CALIBRATE_PASSES;
+    return lcd_bus_stats.errors == 0;
 }
 
 /**
- * @brief Display a text string.
+ * @brief Find the fastest stable burst settings and save them to LCD_PROFILE_PATH.
  *
- * @param x X-coordinate of text origin.
- * @param y Y-coordinate of text origin.
- * @param str String to display.
- * @param font Font set to use.
- * @param color Text foreground color.
- * @param bgcolor Text background color.
- * @return void
+ * Sweeps chunk lengths and inter-chunk delays, keeping the combination with
+ * the shortest full-screen transfer that produced no I2C errors. The chosen
+ * delay is padded by 25% before saving. The time of every stable pass is
+ * also fitted to its message and byte counts, which calibrates the bus cost
+ * model lcd_flush() uses to choose how to send a frame.
+ *
+ * @return 0 on success, 1 if no setting was stable or the profile could not be saved.
  */
-void lcd_write_string(uint16_t x, uint16_t y, char *str, FontDef font, uint16_t color, uint16_t bgcolor)
+uint8_t lcd_calibrate(void)
 {
+    static const uint16_t lengths[] = {32, 64, 96, 128, 160, 192, 256};
+    static const uint16_t delays[] = {1000, 700, 500, 350, 250, 150, 100, 50, 0};
+    // normal equations of the least-squares cost model fit
+    double mm = 0, mb = 0, bb = 0, my = 0, by = 0, m = 0, b = 0, y = 0, det = 0;
+    uint32_t elapsed = 0;
+    uint32_t best = UINT32_MAX;
+    uint16_t bestLength = 0;
+    uint16_t bestDelay = 0;
+    uint8_t i = 0;
+    uint8_t j = 0;
 
-    while (*str)
+    lcd_calibrating = true;
+    for (i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++)
     {
-        if (x + font.width >= ST7735_WIDTH)
+        for (j = 0; j < sizeof(delays) / sizeof(delays[0]); j++)
         {
-            x = 0;
-            y += font.height;
-            if (y + font.height >= ST7735_HEIGHT)
+            i2c_burst_length = lengths[i];
+            i2c_burst_delay_us = delays[j];
+            if (!lcd_calibrate_pass(&elapsed))
             {
+                fprintf(stderr, "st7735: %3u bytes / %4u us: unstable\n", lengths[i], delays[j]);
+                // shorter delays will not do better at this length
                 break;
             }
-
-            if (*str == ' ')
+            fprintf(stderr, "st7735: %3u bytes / %4u us: %u us per frame\n", lengths[i], delays[j], elapsed);
+            // what the pass took beyond its pacing delays, against its messages and bytes
+            m = (double)lcd_planned.messages / LCD_CALIBRATE_PASSES;
+            b = (double)lcd_planned.bytes / LCD_CALIBRATE_PASSES;
+            y = elapsed * 1000.0 - lcd_planned.sleep_us * 1000.0 / LCD_CALIBRATE_PASSES;
+            mm += m * m;
+            mb += m * b;
+            bb += b * b;
+            my += m * y;
+            by += b * y;
+            if (elapsed < best)
             {
-                // skip spaces in the beginning of the new line
-                str++;
-                continue;
+                best = elapsed;
+                bestLength = lengths[i];
+                bestDelay = delays[j];
             }
         }
-
-        lcd_write_char(x, y, *str, font, color, bgcolor);
-        i2c_write_command(SYNC_REG, 0x00, 0x01);
-        x += font.width;
-        str++;
     }
-}
+    lcd_calibrating = false;
 
-void lcd_write_str(uint16_t x, uint16_t y, char *str, FontType font, uint16_t color, uint16_t bgcolor)
-{
-    switch (font)
+    lcd_fill_screen(ST7735_BLACK);
+    if (bestLength == 0)
     {
-    case FontType_7x10:
-        lcd_write_string(x, y, str, Font_7x10, color, bgcolor);
-        break;
-    case FontType_8x16:
-        lcd_write_string(x, y, str, Font_8x16, color, bgcolor);
-        break;
-    case FontType_11x18:
-        lcd_write_string(x, y, str, Font_11x18, color, bgcolor);
-        break;
-    case FontType_16x26:
-        lcd_write_string(x, y, str, Font_16x26, color, bgcolor);
-        break;
+        fprintf(stderr, "st7735: No stable burst setting found\n");
+        i2c_burst_length = BURST_MAX_LENGTH;
+        i2c_burst_delay_us = BURST_DELAY_US;
+        lcd_flush();
+        return 1;
     }
-}
 
-/**
- * @brief Flood fill rectangle with selected color.
- *
- * @param x X-coordinate of rectangle origin.
- * @param y Y-coordinate of rectangle origin.
- * @param w Width of rectangle in pixels.
- * @param h Height of rectangle in pixels.
- * @param color Color to fill with.
- * @return void
- */
-void lcd_fill_rectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
-{
-    uint8_t buff[320] = {0};
-    uint16_t count = 0;
-    // clipping
-    if ((x >= ST7735_WIDTH) || (y >= ST7735_HEIGHT))
-        return;
-    if ((x + w - 1) >= ST7735_WIDTH)
-        w = ST7735_WIDTH - x;
-    if ((y + h - 1) >= ST7735_HEIGHT)
-        h = ST7735_HEIGHT - y;
-    lcd_set_address_window(x, y, x + w - 1, y + h - 1);
+    i2c_burst_length = bestLength;
+    i2c_burst_delay_us = bestDelay + bestDelay / 4;
+    lcd_flush();
+    fprintf(stderr, "st7735: Using %u bytes / %u us\n", i2c_burst_length, i2c_burst_delay_us);
 
-    for (count = 0; count < w; count++)
+    // the chunk lengths vary the message count against a fixed byte count, which separates the two costs
+    det = mm * bb - mb * mb;
+    m = (det > 0) ? (my * bb - by * mb) / det : -1;
+    b = (det > 0) ? (by * mm - my * mb) / det : -1;
+    if ((m >= 0) && (b > 0))
     {
-        buff[count * 2] = color >> 8;
-        buff[count * 2 + 1] = color & 0xFF;
+        lcd_cost_message_ns = m;
+        lcd_cost_byte_ns = b;
+        fprintf(stderr, "st7735: Bus cost %u ns per message, %u ns per byte\n", lcd_cost_message_ns, lcd_cost_byte_ns);
     }
-    for (y = h; y > 0; y--)
+    else
     {
-        i2c_burst_transfer(buff, sizeof(uint16_t) * w);
+        fprintf(stderr, "st7735: Unable to fit the bus cost model, keeping %u ns per message, %u ns per byte\n",
+                lcd_cost_message_ns, lcd_cost_byte_ns);
     }
+    return lcd_save_profile(LCD_PROFILE_PATH);
+}
+
+void i2c_burst_transfer(uint8_t *buff, uint32_t length)
+{
+    i2c_batch_command(BURST_WRITE_REG, 0x00, 0x01);
+    i2c_batch_submit();
+    i2c_burst_chunks(buff, length);
+    i2c_batch_command(BURST_WRITE_REG, 0x00, 0x00);
+    i2c_batch_command(SYNC_REG, 0x00, 0x01);
+    i2c_batch_submit();
 }
 
+// Pages in the order lcd_display() rotates through them
+enum
+{
+    LCD_PAGE_CPU = 0,
+    LCD_PAGE_RAM,
+    LCD_PAGE_TEMP,
+    LCD_PAGE_DISK,
+    LCD_PAGE_NET,
+    LCD_PAGE_IO
+};
+
 /**
- * @brief Flood fill screen with selected color.
+ * @brief Header text shown on every page: the address, CUSTOM_DISPLAY or the hostname.
  *
- * @param color Color to fill with.
+ * @param m Metrics snapshot.
+ * @param buf Destination.
+ * @param size Size of buf, at most 20 for the 8x16 font.
  * @return void
  */
-void lcd_fill_screen(uint16_t color)
+static void lcd_header_text(const Metrics *m, char *buf, size_t size)
 {
-    lcd_fill_rectangle(0, 0, ST7735_WIDTH, ST7735_HEIGHT, color);
-    i2c_write_command(SYNC_REG, 0x00, 0x01);
+    // the precision tells gcc the cut is meant; long hostnames are clipped to the header
+    if (DISPLAY_IP_ADDR)
+        snprintf(buf, size, "%.*s", (int)size - 1, m->ipAddress); // IP address of the default interface
+    else
+        snprintf(buf, size, "%.*s", (int)size - 1, (*CUSTOM_DISPLAY != '\0') ? CUSTOM_DISPLAY : m->hostname);
 }
 
-void lcd_draw_image(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+/**
+ * @brief Put a page's static layer into the framebuffer.
+ *
+ * The layer is rasterized on first use, and again when the header text
+ * changes: black background, header, blue divider, the page's own labels
+ * from chrome(), and the ten empty bar slots. Switching pages copies the
+ * layer over the whole framebuffer, so the next flush sends only what
+ * differs from the previous page. Showing the same page again leaves the
+ * framebuffer alone, and the page's widgets redraw only values that changed.
+ *
+ * @param page Page number as in lcd_display().
+ * @param m Metrics snapshot the header is taken from.
+ * @param chrome Draws the page's labels and units.
+ * @return void
+ */
+static void lcd_page_begin(uint8_t page, const Metrics *m, void (*chrome)(void))
 {
-    uint16_t col = h - y;
-    uint16_t row = w - x;
-    lcd_set_address_window(x, y, x + w - 1, y + h - 1);
-    i2c_burst_transfer(data, sizeof(uint16_t) * col * row);
-}
+    char header[sizeof(lcd_layer_header[0])];
 
-uint8_t lcd_begin(void)
-{
-    uint8_t count = 0;
-    uint8_t buffer[20] = {0};
-    uint8_t i2c[20] = "/dev/i2c-1";
-    // I2C Init
-    i2cd = open(i2c, O_RDWR); //"/dev/i2c-1"
-    if (i2cd < 0)
+    lcd_header_text(m, header, sizeof(header));
+    if (lcd_layer_valid[page] && (strcmp(header, lcd_layer_header[page]) == 0))
     {
-        fprintf(stderr, "Device I2C-1 failed to initialize\n");
-        return 1;
+        if (lcd_page_current != page)
+        {
+            memcpy(lcd_framebuffer, lcd_layers[page], sizeof(lcd_framebuffer));
+            lcd_mark_dirty(0, 0, ST7735_WIDTH, ST7735_HEIGHT);
+            lcd_page_current = page;
+            lcd_layer_copies++;
+        }
+        return;
     }
-    if (ioctl(i2cd, I2C_SLAVE_FORCE, I2C_ADDRESS) < 0)
+
+    lcd_fill_screen(ST7735_BLACK);
+    if (DISPLAY_IP_ADDR)
     {
-        return 1;
+        lcd_write_string(0, 0, "IP:", Font_8x16, ST7735_WHITE, ST7735_BLACK);
+        lcd_write_string(24, 0, header, Font_8x16, ST7735_WHITE, ST7735_BLACK);
     }
-    return 0;
-}
+    else
+    {
+        // Maximum of 20 characters for 8x16 font
+        // Center 8x16 font
+        lcd_write_string(4 + ((19 - strlen(header)) / 2 * 8), 0, header, Font_8x16, ST7735_WHITE, ST7735_BLACK);
+    }
+    lcd_fill_rectangle(0, 20, ST7735_WIDTH, 5, ST7735_BLUE);
+    chrome();
+    lcd_fill_segments(30, 60, 10, 6, 10, 10, ST7735_GRAY);
 
-void i2c_write_data(uint8_t high, uint8_t low)
-{
-    uint8_t msg[3] = {WRITE_DATA_REG, high, low};
-    write(i2cd, msg, 3);
-    usleep(10);
+    memcpy(lcd_layers[page], lcd_framebuffer, sizeof(lcd_framebuffer));
+    strcpy(lcd_layer_header[page], header);
+    lcd_layer_valid[page] = true;
+    lcd_page_current = page;
+    lcd_layer_copies++;
 }
 
-void i2c_write_command(uint8_t command, uint8_t high, uint8_t low)
+/**
+ * @brief Identify the current copy of the page's static layer in the framebuffer.
+ *
+ * Changes whenever a layer is copied or rebuilt into the framebuffer, which
+ * resets everything drawn over it.
+ *
+ * @return Serial number of the copy.
+ */
+uint32_t lcd_layer_serial(void)
 {
-    uint8_t msg[3] = {command, high, low};
-    write(i2cd, msg, 3);
-    usleep(10);
+    return lcd_layer_copies;
 }
 
-void i2c_burst_transfer(uint8_t *buff, uint32_t length)
+/**
+ * @brief Copy a region of the current page's static layer back into the framebuffer.
+ *
+ * @param x X-coordinate of region origin.
+ * @param y Y-coordinate of region origin.
+ * @param w Width of region in pixels.
+ * @param h Height of region in pixels.
+ * @return void
+ */
+void lcd_restore_layer(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
 {
-    uint32_t count = 0;
-    i2c_write_command(BURST_WRITE_REG, 0x00, 0x01);
-    while (length > count)
+    uint16_t row = 0;
+
+    if ((lcd_page_current < 0) || (x >= ST7735_WIDTH) || (y >= ST7735_HEIGHT))
+        return;
+    if ((x + w - 1) >= ST7735_WIDTH)
+        w = ST7735_WIDTH - x;
+    if ((y + h - 1) >= ST7735_HEIGHT)
+        h = ST7735_HEIGHT - y;
+
+    for (row = y; row < y + h; row++)
     {
-        if ((length - count) > BURST_MAX_LENGTH)
-        {
-            write(i2cd, buff + count, BURST_MAX_LENGTH);
-            count += BURST_MAX_LENGTH;
-        }
-        else
-        {
-            write(i2cd, buff + count, length - count);
-            count += (length - count);
-        }
-        usleep(700);
+        memcpy(&lcd_framebuffer[row][x * 2], &lcd_layers[lcd_page_current][row][x * 2], sizeof(uint16_t) * w);
     }
-    i2c_write_command(BURST_WRITE_REG, 0x00, 0x00);
-    i2c_write_command(SYNC_REG, 0x00, 0x01);
+    lcd_mark_dirty(x, y, w, h);
 }
 
 void lcd_display(uint8_t symbol)
 {
     switch (symbol)
     {
-    case 0:
+    case LCD_PAGE_CPU:
         lcd_display_cpuLoad();
         break;
-    case 1:
+    case LCD_PAGE_RAM:
         lcd_display_ram();
         break;
-    case 2:
+    case LCD_PAGE_TEMP:
         lcd_display_temp();
         break;
-    case 3:
+    case LCD_PAGE_DISK:
         lcd_display_disk();
         break;
+    case LCD_PAGE_NET:
+        lcd_display_net();
+        break;
+    case LCD_PAGE_IO:
+        lcd_display_io();
+        break;
     default:
         break;
     }
+    lcd_flush();
 }
 
+/**
+ * @brief Draw the ten-segment percentage bar once, without widget state.
+ *
+ * Every segment is repainted; pages keep a BarWidget instead, which repaints
+ * only the segments that change.
+ *
+ * @param val Percentage.
+ * @param color Color of the lit segments.
+ * @return void
+ */
 void lcd_display_percentage(uint8_t val, uint16_t color)
 {
-    uint8_t count = 0;
-    uint8_t xCoordinate = 30;
-    val += 10;
-    if (val >= 100)
-    {
-        val = 100;
-    }
-    val /= 10;
-    for (count = 0; count < val; count++)
-    {
-        lcd_fill_rectangle(xCoordinate, 60, 6, 10, color);
-        xCoordinate += 10;
-    }
-    for (count = 0; count < 10 - val; count++)
-    {
-        lcd_fill_rectangle(xCoordinate, 60, 6, 10, ST7735_GRAY);
-        xCoordinate += 10;
-    }
+    BarWidget bar = PERCENT_BAR_WIDGET(color);
+
+    // start from every segment lit, so clearing them paints the whole bar gray
+    bar.lit = bar.segments;
+    bar.layer = lcd_layer_serial();
+    widget_bar_set(&bar, 0);
+    widget_bar_set_percent(&bar, val);
+}
+
+// Dynamic fields of each page, drawn over its static layer
+static NumberWidget lcd_cpu_value = NUMBER_WIDGET(80, 35, 33, Font_11x18);
+static BarWidget lcd_cpu_bar = PERCENT_BAR_WIDGET(ST7735_GREEN);
+static NumberWidget lcd_ram_value = NUMBER_WIDGET(80, 35, 33, Font_11x18);
+static BarWidget lcd_ram_bar = PERCENT_BAR_WIDGET(ST7735_YELLOW);
+static NumberWidget lcd_temp_value = NUMBER_WIDGET(85, 35, 33, Font_11x18);
+static BarWidget lcd_temp_bar = PERCENT_BAR_WIDGET(ST7735_RED);
+static NumberWidget lcd_disk_value = NUMBER_WIDGET(85, 35, 33, Font_11x18);
+static BarWidget lcd_disk_bar = PERCENT_BAR_WIDGET(ST7735_BLUE);
+static TextWidget lcd_disk_mounts = TEXT_WIDGET_CENTERED(0, 70, ST7735_WIDTH, Font_7x10);
+// "eth0  RX  12.3 Mb/s" on a 7 pixel grid, labels in the static layer
+static TextWidget lcd_net_name = TEXT_WIDGET(13, 35, 5 * 7, Font_7x10);
+static TextWidget lcd_net_rx = TEXT_WIDGET(76, 35, 10 * 7, Font_7x10);
+static TextWidget lcd_net_tx = TEXT_WIDGET(76, 45, 10 * 7, Font_7x10);
+static BarWidget lcd_net_bar = PERCENT_BAR_WIDGET(ST7735_CYAN);
+// "mmcblk0 R  12.3 KB/s" over "   42/s W   1.0 KB/s"
+static TextWidget lcd_io_name = TEXT_WIDGET(10, 35, 7 * 7, Font_7x10);
+static TextWidget lcd_io_read = TEXT_WIDGET(80, 35, 10 * 7, Font_7x10);
+static TextWidget lcd_io_iops = TEXT_WIDGET(10, 45, 5 * 7, Font_7x10);
+static TextWidget lcd_io_write = TEXT_WIDGET(80, 45, 10 * 7, Font_7x10);
+// "await R 1.2 W 0.8 ms" under the bar
+static TextWidget lcd_io_await = TEXT_WIDGET_CENTERED(0, 70, ST7735_WIDTH, Font_7x10);
+static BarWidget lcd_io_bar = PERCENT_BAR_WIDGET(ST7735_MAGENTA);
+
+static void lcd_chrome_cpuLoad(void)
+{
+    lcd_write_string(36, 35, "CPU:", Font_11x18, ST7735_WHITE, ST7735_BLACK);
+    lcd_write_string(113, 35, "%", Font_11x18, ST7735_WHITE, ST7735_BLACK);
 }
 
 /**
@@ -311,42 +1752,29 @@ void lcd_display_percentage(uint8_t val, uint16_t color)
  */
 void lcd_display_cpuLoad(void)
 {
-    char hostname[HOST_NAME_MAX + 1];
-    char buffer[20] = {0};
+    Metrics m;
     uint8_t cpuLoad = 0;
-    char cpuStr[10] = {0};
 
-    gethostname(hostname, HOST_NAME_MAX + 1);
+    GetMetrics(&m);
 
     /*
-    printf("hostname: %s\n", hostname);
+    printf("hostname: %s\n", m.hostname);
     */
 
-    lcd_fill_screen(ST7735_BLACK);
-    lcd_fill_rectangle(0, 20, ST7735_WIDTH, 5, ST7735_BLUE);
+    lcd_page_begin(LCD_PAGE_CPU, &m, lcd_chrome_cpuLoad);
 
     // cpuLoad = GetCPUUsageTop();
-    cpuLoad = GetCPUUsagePstat();
-    sprintf(cpuStr, "%u", cpuLoad);
+    // cpuLoad = GetCPUUsagePstat();
+    cpuLoad = m.cpuUsage;
 
-    if (DISPLAY_IP_ADDR)
-    {
-        lcd_write_string(0, 0, "IP:", Font_8x16, ST7735_WHITE, ST7735_BLACK);
-        strcpy(buffer, GetIPAddress()); // Get the IP address of the default interface
-        lcd_write_string(24, 0, buffer, Font_8x16, ST7735_WHITE, ST7735_BLACK);
-    }
-    else
-    {
-        strncpy(buffer, (*CUSTOM_DISPLAY != '\0') ? CUSTOM_DISPLAY : hostname, sizeof(buffer) - 1);
-        // Maximum of 20 characters for 8x16 font
-        // Center 8x16 font
-        lcd_write_string(4 + ((19 - strlen(buffer)) / 2 * 8), 0, buffer, Font_8x16, ST7735_WHITE, ST7735_BLACK);
-    }
+    widget_number_set(&lcd_cpu_value, cpuLoad);
+    widget_bar_set_percent(&lcd_cpu_bar, cpuLoad);
+}
 
-    lcd_write_string(36, 35, "CPU:", Font_11x18, ST7735_WHITE, ST7735_BLACK);
-    lcd_write_string(80, 35, cpuStr, Font_11x18, ST7735_WHITE, ST7735_BLACK);
+static void lcd_chrome_ram(void)
+{
+    lcd_write_string(36, 35, "RAM:", Font_11x18, ST7735_WHITE, ST7735_BLACK);
     lcd_write_string(113, 35, "%", Font_11x18, ST7735_WHITE, ST7735_BLACK);
-    lcd_display_percentage(cpuLoad, ST7735_GREEN);
 }
 
 /**
@@ -356,35 +1784,20 @@ void lcd_display_cpuLoad(void)
  */
 void lcd_display_ram(void)
 {
+    Metrics m;
     uint8_t ramPct = 0;
-    char ramStr[10] = {0};
 
-    ramPct = GetMemory();
-    sprintf(ramStr, "%d", ramPct);
+    GetMetrics(&m);
+    ramPct = m.memoryPct;
 
-    lcd_fill_rectangle(0, 35, ST7735_WIDTH, 20, ST7735_BLACK);
-    lcd_write_string(36, 35, "RAM:", Font_11x18, ST7735_WHITE, ST7735_BLACK);
-    lcd_write_string(80, 35, ramStr, Font_11x18, ST7735_WHITE, ST7735_BLACK);
-    lcd_write_string(113, 35, "%", Font_11x18, ST7735_WHITE, ST7735_BLACK);
-    lcd_display_percentage(ramPct, ST7735_YELLOW);
+    lcd_page_begin(LCD_PAGE_RAM, &m, lcd_chrome_ram);
+    widget_number_set(&lcd_ram_value, ramPct);
+    widget_bar_set_percent(&lcd_ram_bar, ramPct);
 }
 
-/**
- * @brief Display CPU temperature.
- *
- * @return void
- */
-void lcd_display_temp(void)
+static void lcd_chrome_temp(void)
 {
-    uint16_t temp = 0;
-    char tempStr[10] = {0};
-
-    temp = GetCPUTemperature();
-    sprintf(tempStr, "%d", temp);
-
-    lcd_fill_rectangle(0, 35, ST7735_WIDTH, 20, ST7735_BLACK);
     lcd_write_string(30, 35, "TEMP:", Font_11x18, ST7735_WHITE, ST7735_BLACK);
-    lcd_write_string(85, 35, tempStr, Font_11x18, ST7735_WHITE, ST7735_BLACK);
     if (TEMPERATURE_TYPE == FAHRENHEIT)
     {
         lcd_write_string(118, 35, "F", Font_11x18, ST7735_WHITE, ST7735_BLACK);
@@ -393,12 +1806,35 @@ void lcd_display_temp(void)
     {
         lcd_write_string(118, 35, "C", Font_11x18, ST7735_WHITE, ST7735_BLACK);
     }
+}
+
+/**
+ * @brief Display CPU temperature.
+ *
+ * @return void
+ */
+void lcd_display_temp(void)
+{
+    Metrics m;
+    uint16_t temp = 0;
+
+    GetMetrics(&m);
+    temp = m.temperature;
+
+    lcd_page_begin(LCD_PAGE_TEMP, &m, lcd_chrome_temp);
+    widget_number_set(&lcd_temp_value, temp);
     if (TEMPERATURE_TYPE == FAHRENHEIT)
     {
         temp -= 32;
         temp /= 1.8;
     }
-    lcd_display_percentage((uint16_t)((float)temp / 85 * 100.0), ST7735_RED);
+    widget_bar_set_percent(&lcd_temp_bar, (uint16_t)((float)temp / 85 * 100.0));
+}
+
+static void lcd_chrome_disk(void)
+{
+    lcd_write_string(30, 35, "DISK:", Font_11x18, ST7735_WHITE, ST7735_BLACK);
+    lcd_write_string(118, 35, "%", Font_11x18, ST7735_WHITE, ST7735_BLACK);
 }
 
 /**
@@ -408,16 +1844,159 @@ void lcd_display_temp(void)
  */
 void lcd_display_disk(void)
 {
+    Metrics m;
     uint8_t fsUsed = 0;
-    char fsStr[10] = {0};
+    char mountStr[23] = {0};
+    const FSUsage *fs;
+    const char *name;
+    uint8_t i = 0;
+    size_t len = 0;
 
+    GetMetrics(&m);
     // fsUsed = GetFSMemoryStatfs();
-    fsUsed = GetFSMemoryDf();
-    sprintf(fsStr, "%u", fsUsed);
+    // fsUsed = GetFSMemoryDf();
+    fsUsed = m.fs[0].usedPct;
 
-    lcd_fill_rectangle(0, 35, ST7735_WIDTH, 20, ST7735_BLACK);
-    lcd_write_string(30, 35, "DISK:", Font_11x18, ST7735_WHITE, ST7735_BLACK);
-    lcd_write_string(85, 35, fsStr, Font_11x18, ST7735_WHITE, ST7735_BLACK);
-    lcd_write_string(118, 35, "%", Font_11x18, ST7735_WHITE, ST7735_BLACK);
-    lcd_display_percentage(fsUsed, ST7735_BLUE);
+    lcd_page_begin(LCD_PAGE_DISK, &m, lcd_chrome_disk);
+    widget_number_set(&lcd_disk_value, fsUsed);
+    widget_bar_set_percent(&lcd_disk_bar, fsUsed);
+
+    // Other configured mounts go on the bottom line as "name NN%", by last path component
+    for (i = 1; i < m.fsCount; i++)
+    {
+        fs = &m.fs[i];
+        name = strrchr(fs->mountPoint, '/');
+        name = ((name != NULL) && (name[1] != '\0')) ? name + 1 : fs->mountPoint;
+        if (fs->mounted)
+            snprintf(mountStr + len, sizeof(mountStr) - len, "%s%s %u%%", (len > 0) ? " " : "", name, fs->usedPct);
+        else
+            snprintf(mountStr + len, sizeof(mountStr) - len, "%s%s -", (len > 0) ? " " : "", name);
+        len = strlen(mountStr);
+    }
+    widget_text_set(&lcd_disk_mounts, mountStr);
+}
+
+/**
+ * @brief Format a rate with a K/M/G prefix in 10 characters.
+ *
+ * @param buf Destination, at least 11 bytes.
+ * @param size Size of buf.
+ * @param value Rate in units per second.
+ * @param unit "b/s" or "B/s".
+ * @return void
+ */
+static void lcd_format_rate(char *buf, size_t size, double value, const char *unit)
+{
+    if (value >= 1e9)
+        snprintf(buf, size, "%5.1f G%s", value / 1e9, unit);
+    else if (value >= 1e6)
+        snprintf(buf, size, "%5.1f M%s", value / 1e6, unit);
+    else if (value >= 1e3)
+        snprintf(buf, size, "%5.1f K%s", value / 1e3, unit);
+    else
+        snprintf(buf, size, "%5.0f  %s", value, unit);
+}
+
+static void lcd_chrome_net(void)
+{
+    lcd_write_string(55, 35, "RX", Font_7x10, ST7735_WHITE, ST7735_BLACK);
+    lcd_write_string(55, 45, "TX", Font_7x10, ST7735_WHITE, ST7735_BLACK);
+}
+
+/**
+ * @brief Display default interface throughput.
+ *
+ * The bar shows the busier direction against the negotiated link speed.
+ *
+ * @return void
+ */
+void lcd_display_net(void)
+{
+    Metrics m;
+    char rxStr[12] = {0};
+    char txStr[12] = {0};
+    char name[6] = {0};
+    int32_t speed = 0;
+    uint64_t peak = 0;
+    uint8_t netPct = 0;
+
+    GetMetrics(&m);
+    speed = m.linkSpeed;
+    if (speed <= 0)
+    {
+        speed = NET_SPEED_FALLBACK_MBPS;
+    }
+    peak = (m.net.rxBytesRate > m.net.txBytesRate) ? m.net.rxBytesRate : m.net.txBytesRate;
+    netPct = (peak * 8 >= (uint64_t)speed * 1000000) ? 100 : peak * 8 * 100 / ((uint64_t)speed * 1000000);
+
+    lcd_format_rate(rxStr, sizeof(rxStr), m.net.rxBytesRate * 8.0, "b/s");
+    lcd_format_rate(txStr, sizeof(txStr), m.net.txBytesRate * 8.0, "b/s");
+    snprintf(name, sizeof(name), "%.5s", m.ifname);
+
+    lcd_page_begin(LCD_PAGE_NET, &m, lcd_chrome_net);
+    widget_text_set(&lcd_net_name, name);
+    widget_text_set(&lcd_net_rx, rxStr);
+    widget_text_set(&lcd_net_tx, txStr);
+    widget_bar_set_percent(&lcd_net_bar, netPct);
+}
+
+// Milliseconds with one decimal below 100, whole above, in at most four characters
+static void lcd_format_await(char *buf, size_t size, uint32_t us)
+{
+    if (us >= 9999500)
+        snprintf(buf, size, "9999");
+    else if (us >= 99950)
+        snprintf(buf, size, "%u", (us + 500) / 1000);
+    else
+        snprintf(buf, size, "%.1f", us / 1000.0);
+}
+
+static void lcd_chrome_io(void)
+{
+    lcd_write_string(66, 35, "R", Font_7x10, ST7735_WHITE, ST7735_BLACK);
+    lcd_write_string(45, 45, "/s W", Font_7x10, ST7735_WHITE, ST7735_BLACK);
+}
+
+/**
+ * @brief Display block device I/O.
+ *
+ * Shows the busiest of DISK_DEVICES: read and write throughput, total IOPS,
+ * a bar with the share of time the device was busy, and the average read
+ * and write latency.
+ *
+ * @return void
+ */
+void lcd_display_io(void)
+{
+    Metrics m;
+    DiskStats *disk = &m.disk;
+    char readStr[12] = {0};
+    char writeStr[12] = {0};
+    char name[8] = {0};
+    char iopsStr[12] = {0};
+    char awaitStr[24] = {0};
+    char readAwait[8] = {0};
+    char writeAwait[8] = {0};
+
+    GetMetrics(&m);
+    if (!m.diskPresent)
+    {
+        strcpy(disk->name, "-");
+    }
+
+    lcd_format_rate(readStr, sizeof(readStr), disk->readBytesRate, "B/s");
+    lcd_format_rate(writeStr, sizeof(writeStr), disk->writeBytesRate, "B/s");
+    snprintf(name, sizeof(name), "%.7s", disk->name);
+    snprintf(iopsStr, sizeof(iopsStr), "%5u", disk->readIops + disk->writeIops);
+    lcd_format_await(readAwait, sizeof(readAwait), disk->readAwaitUs);
+    lcd_format_await(writeAwait, sizeof(writeAwait), disk->writeAwaitUs);
+    snprintf(awaitStr, sizeof(awaitStr), "await R %s W %s ms", readAwait, writeAwait);
+
+    lcd_page_begin(LCD_PAGE_IO, &m, lcd_chrome_io);
+    widget_text_set(&lcd_io_name, name);
+    widget_text_set(&lcd_io_read, readStr);
+    widget_text_set(&lcd_io_iops, iopsStr);
+    widget_text_set(&lcd_io_write, writeStr);
+    widget_bar_set_percent(&lcd_io_bar, disk->utilPct);
+    widget_text_set(&lcd_io_await, awaitStr);
 }
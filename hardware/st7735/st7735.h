@@ -6,6 +6,39 @@
 
 #define I2C_ADDRESS 0x18
 #define BURST_MAX_LENGTH 160
+#define BURST_DELAY_US 700
+// Bounds for calibrated and backed-off burst settings
+#define BURST_MIN_LENGTH 16
+#define BURST_LENGTH_MAX 256
+#define BURST_DELAY_MAX 5000
+#define BURST_RETRY_MAX 3
+// Burst settings written by "display --calibrate" and loaded by lcd_begin()
+#define LCD_PROFILE_PATH "/etc/rm0004-st7735.conf"
+#define LCD_CALIBRATE_PASSES 3
+// Register writes combined into one I2C_RDWR transaction
+#define I2C_BATCH_MAX 8
+// One full-width line of the tallest font expanded to RGB565
+#define LCD_SPAN_MAX_BYTES (ST7735_WIDTH * 26 * 2)
+// Number of separate dirty rectangles tracked before merging
+#define LCD_DIRTY_MAX 8
+// Granularity of the framebuffer/panel comparison in lcd_flush()
+#define LCD_TILE_SIZE 8
+#define LCD_TILES_X ((ST7735_WIDTH + LCD_TILE_SIZE - 1) / LCD_TILE_SIZE)
+#define LCD_TILES_Y ((ST7735_HEIGHT + LCD_TILE_SIZE - 1) / LCD_TILE_SIZE)
+// Bus cost model until lcd_calibrate() fits it: one byte time at 400 kHz per
+// payload byte, and per message for its address byte
+#define LCD_COST_BYTE_NS 22500
+#define LCD_COST_MESSAGE_NS 22500
+// Frame buffers shared by the renderer and the transfer thread
+#define LCD_FRAME_SLOTS 3
+// Pages shown in rotation by lcd_display(): CPU, RAM, temperature, disk, network, I/O
+#define LCD_PAGE_COUNT 6
+// Time each page stays on screen, and before the first one while metrics warm up
+#define LCD_PAGE_INTERVAL_MS 2000
+#define LCD_FIRST_PAGE_DELAY_MS 1000
+// How often the daemon logs the bus time predicted and measured per plan and how late
+// pages were, and again on exit
+#define LCD_PLAN_LOG_INTERVAL_MS 3600000
 
 #define X_COORDINATE_MAX 160
 #define X_COORDINATE_MIN 0
@@ -132,23 +165,70 @@ extern "C"
     FontType_16x26
   } FontType;
 
+  // Bus activity counters, used to compare rendering strategies
+  typedef struct BusStats
+  {
+    uint32_t syscalls; // messages and combined transactions handed to the transport
+    uint32_t bytes;    // bytes handed to the transport
+    uint32_t sleep_us; // pacing delays requested after each transfer
+    uint32_t errors;   // transfers the adapter did not fully accept
+  } BusStats;
+
+  // Ways of sending a frame; lcd_flush() uses the cheapest by the bus cost model
+  typedef enum UpdatePlan
+  {
+    LCD_PLAN_FULL = 0, // the whole screen in one window
+    LCD_PLAN_TILES,    // one window per changed tile
+    LCD_PLAN_RECTS,    // changed tiles merged into rectangles
+    LCD_PLAN_PIXELS,   // one window per run of changed pixels on a row
+    LCD_PLAN_COUNT
+  } UpdatePlan;
+
+  // Frames sent with each plan, with the bus time predicted and measured for them
+  typedef struct PlanStats
+  {
+    uint32_t frames[LCD_PLAN_COUNT];
+    uint64_t predicted_us[LCD_PLAN_COUNT];
+    uint64_t actual_us[LCD_PLAN_COUNT];
+  } PlanStats;
+
   extern void lcd_write_string(uint16_t x, uint16_t y, char *str, FontDef font, uint16_t color, uint16_t bgcolor);
   extern void lcd_write_str(uint16_t x, uint16_t y, char *str, FontType font, uint16_t color, uint16_t bgcolor);
   extern void lcd_fill_rectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
   extern void lcd_fill_screen(uint16_t color);
+  extern void lcd_fill_segments(uint16_t x, uint16_t y, uint8_t count, uint16_t w, uint16_t pitch, uint16_t h, uint16_t color);
   extern void lcd_draw_image(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data);
+  extern void lcd_draw_mask(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *mask, uint16_t color, uint16_t bgcolor);
+  extern void lcd_flush(void);
+  extern uint8_t lcd_pipeline_start(void);
+  extern void lcd_pipeline_stop(void);
+  extern void lcd_invalidate(void);
+  extern void lcd_restore_layer(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+  extern uint32_t lcd_layer_serial(void);
+  extern void lcd_get_bus_stats(BusStats *stats);
+  extern void lcd_reset_bus_stats(void);
+  extern void lcd_get_plan_stats(PlanStats *stats);
   extern void lcd_set_address_window(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+  extern void lcd_set_transport(const char *spec);
   extern uint8_t lcd_begin(void);
+  extern void lcd_end(void);
+  extern uint8_t lcd_load_profile(const char *path);
+  extern uint8_t lcd_save_profile(const char *path);
+  extern uint8_t lcd_calibrate(void);
   extern void i2c_write_data(uint8_t high, uint8_t low);
   extern void i2c_write_command(uint8_t command, uint8_t high, uint8_t low);
   extern void lcd_write_char(uint16_t x, uint16_t y, char ch, FontDef font, uint16_t color, uint16_t bgcolor);
   extern void lcd_write_ch(uint16_t x, uint16_t y, char ch, FontType font, uint16_t color, uint16_t bgcolor);
   extern void i2c_burst_transfer(uint8_t *buff, uint32_t length);
+  extern void i2c_batch_command(uint8_t command, uint8_t high, uint8_t low);
+  extern void i2c_batch_submit(void);
   extern void lcd_display(uint8_t symbol);
   extern void lcd_display_cpuLoad(void);
   extern void lcd_display_ram(void);
   extern void lcd_display_temp(void);
   extern void lcd_display_disk(void);
+  extern void lcd_display_net(void);
+  extern void lcd_display_io(void);
   extern void lcd_display_percentage(uint8_t val, uint16_t color);
 #ifdef __cplusplus
 }
@@ -0,0 +1,270 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/ioctl.h>
+#include "emulator.h"
+#include "st7735.h"
+#include "transport.h"
+
+/**
+ * @brief Find the transport named by a spec such as "i2c:/dev/i2c-1", "mock", "record:/tmp/bus.log" or "emu:/tmp/panel.ppm".
+ *
+ * @param spec Transport spec, NULL selects TRANSPORT_DEFAULT.
+ * @return Matching transport, or NULL if the name is unknown.
+ */
+const Transport *transport_find(const char *spec)
+{
+    static const Transport *transports[] = {&transport_i2c, &transport_mock, &transport_record, &transport_emulator};
+    size_t len = 0;
+    uint8_t i = 0;
+
+    if (spec == NULL)
+        spec = TRANSPORT_DEFAULT;
+    len = strcspn(spec, ":");
+
+    for (i = 0; i < sizeof(transports) / sizeof(transports[0]); i++)
+    {
+        if ((strlen(transports[i]->name) == len) && (strncmp(transports[i]->name, spec, len) == 0))
+            return transports[i];
+    }
+    return NULL;
+}
+
+// Set while the open transport can send combined transactions, cleared for
+// adapters that cannot (e.g. SMBus-only ones); one flag, read by st7735.c
+static bool transport_combined = true;
+
+/**
+ * @brief Open a transport with the argument part of a spec.
+ *
+ * @param transport Transport from transport_find().
+ * @param spec Transport spec, NULL selects TRANSPORT_DEFAULT.
+ * @return 0 on success, -1 on failure.
+ */
+int transport_open(const Transport *transport, const char *spec)
+{
+    // assumed until the transport finds otherwise
+    transport_combined = true;
+    return transport->open(transport_arg(spec));
+}
+
+/**
+ * @brief Whether write_commands() of the open transport can succeed.
+ *
+ * Cleared when the i2c-dev adapter does not offer I2C_RDWR, either reported
+ * when it was opened or found on the first combined transfer.
+ *
+ * @return true if combined transactions are available.
+ */
+bool transport_combined_supported(void)
+{
+    return transport_combined;
+}
+
+/**
+ * @brief Get the argument part of a transport spec.
+ *
+ * @param spec Transport spec, NULL selects TRANSPORT_DEFAULT.
+ * @return Text after the first ':', or NULL if there is none.
+ */
+const char *transport_arg(const char *spec)
+{
+    const char *arg;
+
+    if (spec == NULL)
+        spec = TRANSPORT_DEFAULT;
+    arg = strchr(spec, ':');
+    return (arg != NULL) ? arg + 1 : NULL;
+}
+
+/******************************** i2c-dev ********************************/
+
+static int i2cd = -1;
+
+static int i2c_open(const char *arg)
+{
+    unsigned long funcs = 0;
+
+    i2cd = open((arg != NULL) ? arg : "/dev/i2c-1", O_RDWR);
+    if (i2cd < 0)
+    {
+        return -1;
+    }
+    if (ioctl(i2cd, I2C_SLAVE_FORCE, I2C_ADDRESS) < 0)
+    {
+        close(i2cd);
+        i2cd = -1;
+        return -1;
+    }
+    transport_combined = (ioctl(i2cd, I2C_FUNCS, &funcs) == 0) && (funcs & I2C_FUNC_I2C);
+    return 0;
+}
+
+static int i2c_write(const uint8_t *buff, uint32_t length)
+{
+    return write(i2cd, buff, length);
+}
+
+static int i2c_write_commands(const uint8_t *data, uint32_t count)
+{
+    struct i2c_msg msgs[I2C_BATCH_MAX];
+    struct i2c_rdwr_ioctl_data rdwr = {msgs, count};
+    uint32_t i = 0;
+
+    if (!transport_combined || (count > I2C_BATCH_MAX))
+    {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        msgs[i].addr = I2C_ADDRESS;
+        msgs[i].flags = 0;
+        msgs[i].len = 3;
+        msgs[i].buf = (uint8_t *)data + i * 3;
+    }
+    if (ioctl(i2cd, I2C_RDWR, &rdwr) < 0)
+    {
+        // adapters that do not implement I2C_RDWR say so in one of these ways
+        if ((errno == EOPNOTSUPP) || (errno == ENOTTY) || (errno == EINVAL))
+            transport_combined = false;
+        return -1;
+    }
+    return 0;
+}
+
+static void i2c_delay(uint32_t us)
+{
+    usleep(us);
+}
+
+static void i2c_close(void)
+{
+    if (i2cd >= 0)
+    {
+        close(i2cd);
+        i2cd = -1;
+    }
+}
+
+const Transport transport_i2c = {"i2c", i2c_open, i2c_write, i2c_write_commands, i2c_delay, i2c_close, NULL};
+
+/******************************** mock ********************************/
+
+// Virtual bus time: 9 clocks per byte plus the address byte, delays added as-is
+static uint64_t mock_elapsed_us = 0;
+
+static void mock_account(uint32_t length)
+{
+    mock_elapsed_us += (uint64_t)(length + 1) * 9 * 1000000 / TRANSPORT_MOCK_BAUDRATE;
+}
+
+static int mock_open(const char *arg)
+{
+    mock_elapsed_us = 0;
+    return 0;
+}
+
+static int mock_write(const uint8_t *buff, uint32_t length)
+{
+    mock_account(length);
+    return length;
+}
+
+static int mock_write_commands(const uint8_t *data, uint32_t count)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        mock_account(3);
+    }
+    return 0;
+}
+
+static void mock_delay(uint32_t us)
+{
+    mock_elapsed_us += us;
+}
+
+static void mock_close(void)
+{
+}
+
+/**
+ * @brief Get the virtual bus time accumulated by the mock transport.
+ *
+ * @return Microseconds the same traffic would have taken on a real bus.
+ */
+uint64_t transport_mock_elapsed_us(void)
+{
+    return mock_elapsed_us;
+}
+
+const Transport transport_mock = {"mock", mock_open, mock_write, mock_write_commands, mock_delay, mock_close, transport_mock_elapsed_us};
+
+/******************************** record ********************************/
+
+/*
+ * One line per event:
+ *   W <hex bytes>   single I2C message
+ *   C <hex bytes>   register write that was part of a combined transaction
+ *   D <us>          pacing delay
+ */
+static FILE *record_fd = NULL;
+
+static void record_message(char tag, const uint8_t *buff, uint32_t length)
+{
+    uint32_t i = 0;
+
+    fputc(tag, record_fd);
+    for (i = 0; i < length; i++)
+    {
+        fprintf(record_fd, " %02x", buff[i]);
+    }
+    fputc('\n', record_fd);
+}
+
+static int record_open(const char *arg)
+{
+    record_fd = fopen((arg != NULL) ? arg : "st7735.rec", "w");
+    return (record_fd == NULL) ? -1 : 0;
+}
+
+static int record_write(const uint8_t *buff, uint32_t length)
+{
+    record_message('W', buff, length);
+    return length;
+}
+
+static int record_write_commands(const uint8_t *data, uint32_t count)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        record_message('C', data + i * 3, 3);
+    }
+    return 0;
+}
+
+static void record_delay(uint32_t us)
+{
+    fprintf(record_fd, "D %u\n", us);
+}
+
+static void record_close(void)
+{
+    if (record_fd != NULL)
+    {
+        fclose(record_fd);
+        record_fd = NULL;
+    }
+}
+
+const Transport transport_record = {"record", record_open, record_write, record_write_commands, record_delay, record_close, NULL};
@@ -0,0 +1,51 @@
+#ifndef __TRANSPORT_H__
+#define __TRANSPORT_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Default transport when none is selected
+#define TRANSPORT_DEFAULT "i2c:/dev/i2c-1"
+// Bus speed assumed by the mock transport's virtual clock (i2c_arm_baudrate)
+#define TRANSPORT_MOCK_BAUDRATE 400000
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /*
+   * Byte-level link to the display bridge. Each write() is one I2C message
+   * addressed to I2C_ADDRESS; write_commands() sends count 3-byte register
+   * writes as one combined transaction.
+   */
+  typedef struct Transport
+  {
+    const char *name;
+    // open the link, arg is the text after "name:" in the spec (may be NULL)
+    int (*open)(const char *arg);
+    // returns bytes accepted, or -1 with errno set
+    int (*write)(const uint8_t *buff, uint32_t length);
+    // returns 0 on success, or -1 with errno set (EOPNOTSUPP if not available)
+    int (*write_commands)(const uint8_t *data, uint32_t count);
+    void (*delay)(uint32_t us);
+    void (*close)(void);
+    // bus time so far in microseconds for links that only model it, NULL to use the wall clock
+    uint64_t (*clock_us)(void);
+  } Transport;
+
+  extern const Transport transport_i2c;
+  extern const Transport transport_mock;
+  extern const Transport transport_record;
+
+  extern const Transport *transport_find(const char *spec);
+  extern const char *transport_arg(const char *spec);
+  extern int transport_open(const Transport *transport, const char *spec);
+  extern bool transport_combined_supported(void);
+  extern uint64_t transport_mock_elapsed_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __TRANSPORT_H__
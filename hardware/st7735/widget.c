@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <string.h>
+#include "st7735.h"
+#include "widget.h"
+
+/*
+ * Widgets remember what they last drew and touch the framebuffer only when
+ * that changes, so an unchanged value costs no drawing and no dirty region.
+ *
+ * Each widget also records which copy of the page's static layer it drew
+ * over (lcd_layer_serial()). Once the layer has been copied into the
+ * framebuffer again, on a page switch or a rebuild, the framebuffer shows
+ * the layer's background there, and the widget starts over from that state:
+ * no text, no segments lit.
+ */
+
+/**
+ * @brief Show a string, redrawing only if it differs from the one shown.
+ *
+ * Text is white on black; the field's background is restored from the
+ * static layer first, so a shorter string leaves nothing behind.
+ *
+ * @param widget Text widget.
+ * @param text String to show, truncated to WIDGET_TEXT_MAX - 1 characters.
+ * @return void
+ */
+void widget_text_set(TextWidget *widget, const char *text)
+{
+    char buf[WIDGET_TEXT_MAX];
+    uint32_t layer = lcd_layer_serial();
+    uint16_t x = widget->x;
+    uint16_t textWidth = 0;
+
+    snprintf(buf, sizeof(buf), "%s", text);
+    if (widget->layer != layer)
+    {
+        widget->text[0] = '\0';
+        widget->layer = layer;
+    }
+    if (strcmp(widget->text, buf) == 0)
+        return;
+
+    strcpy(widget->text, buf);
+    lcd_restore_layer(widget->x, widget->y, widget->w, widget->font->height);
+    textWidth = strlen(buf) * widget->font->width;
+    if (widget->center && (textWidth < widget->w))
+        x += (widget->w - textWidth) / 2;
+    lcd_write_string(x, widget->y, widget->text, *widget->font, ST7735_WHITE, ST7735_BLACK);
+}
+
+/**
+ * @brief Show a number, formatting and redrawing it only if it changed.
+ *
+ * @param widget Number widget.
+ * @param value Value to show in decimal.
+ * @return void
+ */
+void widget_number_set(NumberWidget *widget, uint32_t value)
+{
+    char buf[12];
+
+    if ((widget->label.layer == lcd_layer_serial()) && (widget->label.text[0] != '\0') && (widget->value == value))
+        return;
+
+    widget->value = value;
+    sprintf(buf, "%u", value);
+    widget_text_set(&widget->label, buf);
+}
+
+/**
+ * @brief Light the first segments of a bar, repainting only those that flip.
+ *
+ * The flipped segments all change the same way, so they are painted with a
+ * single lcd_fill_segments() call and one dirty region.
+ *
+ * @param widget Bar widget.
+ * @param lit Number of segments to light, clamped to the bar length.
+ * @return void
+ */
+void widget_bar_set(BarWidget *widget, uint8_t lit)
+{
+    uint32_t layer = lcd_layer_serial();
+    uint8_t lo = 0;
+    uint8_t hi = 0;
+
+    if (lit > widget->segments)
+        lit = widget->segments;
+    if (widget->layer != layer)
+    {
+        widget->lit = 0;
+        widget->layer = layer;
+    }
+    if (lit == widget->lit)
+        return;
+
+    lo = (lit < widget->lit) ? lit : widget->lit;
+    hi = (lit < widget->lit) ? widget->lit : lit;
+    lcd_fill_segments(widget->x + lo * widget->pitch, widget->y, hi - lo, widget->width, widget->pitch, widget->height,
+                      (lit > widget->lit) ? widget->color : widget->empty);
+    widget->lit = lit;
+}
+
+/**
+ * @brief Show a percentage on a bar, one segment per step with the first always lit.
+ *
+ * A step is 100% / segments, so the ten-segment bar lights one segment per
+ * 10%, like the original lcd_display_percentage().
+ *
+ * @param widget Bar widget.
+ * @param val Percentage, values within the last step light every segment.
+ * @return void
+ */
+void widget_bar_set_percent(BarWidget *widget, uint8_t val)
+{
+    uint32_t lit = (uint32_t)val * widget->segments / 100 + 1;
+
+    widget_bar_set(widget, (lit > widget->segments) ? widget->segments : lit);
+}
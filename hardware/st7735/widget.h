@@ -0,0 +1,65 @@
+#ifndef __WIDGET_H__
+#define __WIDGET_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fonts.h"
+
+// Longest string a text widget shows
+#define WIDGET_TEXT_MAX 24
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  // A string drawn over the page's static layer
+  typedef struct TextWidget
+  {
+    uint16_t x;
+    uint16_t y;
+    uint16_t w; // background restored over this width, the longest value in pixels
+    const FontDef *font;
+    bool center;
+    char text[WIDGET_TEXT_MAX];
+    uint32_t layer; // lcd_layer_serial() the text was drawn over
+  } TextWidget;
+
+  // An unsigned value drawn in decimal
+  typedef struct NumberWidget
+  {
+    TextWidget label;
+    uint32_t value;
+  } NumberWidget;
+
+  // A row of equally spaced segments, lit from the left
+  typedef struct BarWidget
+  {
+    uint16_t x;
+    uint16_t y;
+    uint8_t segments;
+    uint8_t width;
+    uint8_t pitch;
+    uint8_t height;
+    uint16_t color;
+    uint16_t empty; // color of unlit segments in the static layer
+    uint8_t lit;
+    uint32_t layer;
+  } BarWidget;
+
+#define TEXT_WIDGET(x, y, w, font) {(x), (y), (w), &(font), false, {0}, 0}
+#define TEXT_WIDGET_CENTERED(x, y, w, font) {(x), (y), (w), &(font), true, {0}, 0}
+#define NUMBER_WIDGET(x, y, w, font) {TEXT_WIDGET(x, y, w, font), 0}
+// The ten-segment percentage bar every page shows
+#define PERCENT_BAR_WIDGET(color) {30, 60, 10, 6, 10, 10, (color), ST7735_GRAY, 0, 0}
+
+  extern void widget_text_set(TextWidget *widget, const char *text);
+  extern void widget_number_set(NumberWidget *widget, uint32_t value);
+  extern void widget_bar_set(BarWidget *widget, uint8_t lit);
+  extern void widget_bar_set_percent(BarWidget *widget, uint8_t val);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __WIDGET_H__
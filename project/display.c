@@ -1,27 +1,202 @@
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include "drawqueue.h"
+#include "eventloop.h"
+#include "glyph_cache.h"
+#include "rpiInfo.h"
 #include "st7735.h"
+#include "transport.h"
 
-int main(void)
+static void usage(const char *prog)
 {
-	uint8_t symbol = 0;
+	fprintf(stderr, "Usage: %s [--transport i2c[:dev]|mock|record[:file]|emu[:file.ppm]] [--calibrate] [--pages N]\n", prog);
+}
+
+// Page rotation, and how late pages reach the screen against the timer's schedule
+typedef struct
+{
+	uint8_t symbol;
+	int timer;
+	uint32_t pages;
+	uint64_t missed;
+	uint64_t delay_sum_us;
+	int64_t delay_max_us;
+} PageRotation;
+
+static void show_next_page(EventLoop *loop, uint64_t expirations, void *ctx)
+{
+	PageRotation *rotation = ctx;
+	int64_t delay = 0;
+
+	// a late page does not shift the ones after it; the timer keeps its schedule
+	lcd_display(rotation->symbol);
+	rotation->symbol = (rotation->symbol + 1) % LCD_PAGE_COUNT;
+
+	// from the expiry that was due to the page being handed to the bus
+	delay = EventLoopTimerLateUs(rotation->timer);
+	if (delay >= 0)
+	{
+		rotation->pages++;
+		rotation->delay_sum_us += delay;
+		if (delay > rotation->delay_max_us)
+		{
+			rotation->delay_max_us = delay;
+		}
+	}
+	rotation->missed += expirations - 1;
+}
+
+static void print_page_delay(FILE *out, const PageRotation *rotation)
+{
+	if (rotation->pages > 0)
+	{
+		fprintf(out, "page delay: %u pages, mean %.1f us, max %lld us, %llu missed\n", rotation->pages,
+				(double)rotation->delay_sum_us / rotation->pages, (long long)rotation->delay_max_us,
+				(unsigned long long)rotation->missed);
+	}
+}
+
+static void print_plan_stats(FILE *out)
+{
+	static const char *planNames[LCD_PLAN_COUNT] = {"full", "tiles", "rects", "pixels"};
+	PlanStats planStats;
+	int i = 0;
+
+	// predicted against measured bus time, to check the cost model on this node
+	lcd_get_plan_stats(&planStats);
+	for (i = 0; i < LCD_PLAN_COUNT; i++)
+	{
+		if (planStats.frames[i] > 0)
+		{
+			fprintf(out, "plan %s: %u frames, predicted %.1f us/frame, measured %.1f us/frame\n", planNames[i], planStats.frames[i],
+					(double)planStats.predicted_us[i] / planStats.frames[i], (double)planStats.actual_us[i] / planStats.frames[i]);
+		}
+	}
+}
+
+static void log_plan_stats(EventLoop *loop, uint64_t expirations, void *ctx)
+{
+	// the transfer thread keeps sending meanwhile; the copy is taken under its lock
+	print_plan_stats(stderr);
+	print_page_delay(stderr, ctx);
+}
+
+static void run_draw_queue(EventLoop *loop, uint64_t events, void *ctx)
+{
+	// drawing posted from other threads, flushed when they asked for it
+	draw_queue_run();
+}
+
+static void stop_on_signal(EventLoop *loop, uint64_t signo, void *ctx)
+{
+	EventLoopStop(loop);
+}
+
+int main(int argc, char *argv[])
+{
+	PageRotation rotation = {0};
+	uint8_t calibrate = 0;
+	uint32_t pages = 0;
+	uint32_t count = 0;
+	int i = 0;
+	BusStats stats;
+	GlyphCacheStats glyphStats;
+	struct timespec start, end;
+	EventLoop loop;
+	sigset_t signals;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--calibrate") == 0)
+		{
+			calibrate = 1;
+		}
+		else if ((strcmp(argv[i], "--transport") == 0) && (i + 1 < argc))
+		{
+			lcd_set_transport(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--pages") == 0) && (i + 1 < argc))
+		{
+			// render N pages back to back and report bus usage (benchmark mode)
+			pages = strtoul(argv[++i], NULL, 10);
+		}
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
 
 	if (lcd_begin()) // LCD Screen initialization
 	{
 		return 0;
 	}
-	sleep(1);
-	while (1)
+	if (calibrate)
 	{
-		lcd_display(symbol);
-		sleep(1);
-		sleep(1);
-		symbol++;
-		if (symbol == 4)
+		return lcd_calibrate();
+	}
+	if (pages > 0)
+	{
+		MetricsCollectorStart(METRICS_INTERVAL_MS);
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (count = 0; count < pages; count++)
+		{
+			lcd_display(count % LCD_PAGE_COUNT);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		lcd_get_bus_stats(&stats);
+		MetricsCollectorStop();
+		lcd_end();
+		printf("pages: %u\n", pages);
+		printf("wall time: %.3f ms/page\n", ((end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6) / pages);
+		printf("transactions: %.1f/page\n", (double)stats.syscalls / pages);
+		printf("bytes: %.1f/page\n", (double)stats.bytes / pages);
+		printf("pacing delay: %.1f us/page\n", (double)stats.sleep_us / pages);
+		printf("errors: %u\n", stats.errors);
+		glyph_cache_get_stats(&glyphStats);
+		printf("glyph cache: %u hits, %u misses, %u evictions\n", glyphStats.hits, glyphStats.misses, glyphStats.evictions);
+		if (transport_mock_elapsed_us() > 0)
 		{
-			symbol = 0;
+			printf("mock bus time: %.1f us/page\n", (double)transport_mock_elapsed_us() / pages);
 		}
+		print_plan_stats(stdout);
+		return 0;
+	}
+	// This loop only draws: pages, queued drawing and signals. Sampling timers,
+	// netlink and mount events run on the collector thread's own loop, so a slow
+	// read such as statfs() on a hung network mount cannot delay a page.
+	// block the signals before the collector thread starts, so it inherits the mask
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	if (EventLoopInit(&loop) || (EventLoopAddSignals(&loop, &signals, stop_on_signal, NULL) < 0))
+	{
+		lcd_end();
+		return 1;
 	}
+	MetricsCollectorStart(METRICS_INTERVAL_MS);
+	// compose the next page while the previous one is still on the bus
+	lcd_pipeline_start();
+	rotation.timer = EventLoopAddTimer(&loop, LCD_FIRST_PAGE_DELAY_MS, LCD_PAGE_INTERVAL_MS, show_next_page, &rotation);
+	if ((rotation.timer < 0) || (EventLoopAddFd(&loop, draw_queue_fd(), EPOLLIN, run_draw_queue, NULL) < 0) ||
+		(EventLoopAddTimer(&loop, LCD_PLAN_LOG_INTERVAL_MS, LCD_PLAN_LOG_INTERVAL_MS, log_plan_stats, &rotation) < 0))
+	{
+		MetricsCollectorStop();
+		EventLoopClose(&loop);
+		lcd_end();
+		return 1;
+	}
+	EventLoopRun(&loop);
+
+	MetricsCollectorStop();
+	EventLoopClose(&loop);
+	lcd_end();
+	print_plan_stats(stderr);
+	print_page_delay(stderr, &rotation);
 	return 0;
 }
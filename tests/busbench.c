@@ -0,0 +1,235 @@
+/*
+ * Bus usage of the display driver, measurable at any revision.
+ *
+ * Links against the st7735 and rpiInfo sources of whatever tree it is built
+ * in (see tests/busstats.sh) and intercepts the I2C device with --wrap, so
+ * it needs no hardware and no --transport support in the tree under test.
+ * Every message handed to the bus is counted and charged the time it takes
+ * at 400 kHz (9 clocks per byte plus the address byte, like the mock
+ * transport); usleep() is charged as requested but does not sleep.
+ *
+ *   busbench pages N   N pages of the rotation, per-page averages
+ *   busbench glyphs N  one '%' in each font N times, per-glyph averages
+ *   busbench sparse N  N frames of a few scattered small changes, per-frame
+ *                      averages; where the driver has a bus cost model, also
+ *                      the bus time it predicted per plan against the time
+ *                      counted here
+ */
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <sys/types.h>
+#include "st7735.h"
+
+#define BUSBENCH_BAUDRATE 400000
+
+// lcd_flush() and LCD_PAGE_COUNT only exist once the framebuffer does
+extern void lcd_flush(void) __attribute__((weak));
+#ifndef LCD_PAGE_COUNT
+#define LCD_PAGE_COUNT 4
+#endif
+
+static int bus_fd = -1;
+static uint64_t bus_transactions = 0;
+static uint64_t bus_messages = 0;
+static uint64_t bus_bytes = 0;
+static uint64_t bus_sleep_us = 0;
+static double bus_time_us = 0;
+
+extern int __real_open(const char *path, int flags, ...);
+extern ssize_t __real_write(int fd, const void *buff, size_t length);
+extern int __real_ioctl(int fd, unsigned long request, void *arg);
+
+static void bus_message(size_t length)
+{
+    bus_messages++;
+    bus_bytes += length;
+    bus_time_us += (double)(length + 1) * 9 * 1000000 / BUSBENCH_BAUDRATE;
+}
+
+int __wrap_open(const char *path, int flags, ...)
+{
+    va_list ap;
+    int mode = 0;
+
+    if (strncmp(path, "/dev/i2c", 8) == 0)
+    {
+        bus_fd = __real_open("/dev/null", O_RDWR);
+        return bus_fd;
+    }
+    va_start(ap, flags);
+    mode = va_arg(ap, int);
+    va_end(ap);
+    return __real_open(path, flags, mode);
+}
+
+ssize_t __wrap_write(int fd, const void *buff, size_t length)
+{
+    if ((fd < 0) || (fd != bus_fd))
+        return __real_write(fd, buff, length);
+    bus_transactions++;
+    bus_message(length);
+    return length;
+}
+
+int __wrap_ioctl(int fd, unsigned long request, void *arg)
+{
+    struct i2c_rdwr_ioctl_data *rdwr = arg;
+    uint32_t i = 0;
+
+    if ((fd < 0) || (fd != bus_fd))
+        return __real_ioctl(fd, request, arg);
+    switch (request)
+    {
+    case I2C_FUNCS:
+        *(unsigned long *)arg = I2C_FUNC_I2C;
+        return 0;
+    case I2C_RDWR:
+        bus_transactions++;
+        for (i = 0; i < rdwr->nmsgs; i++)
+        {
+            bus_message(rdwr->msgs[i].len);
+        }
+        return rdwr->nmsgs;
+    default:
+        return 0;
+    }
+}
+
+int __wrap_usleep(useconds_t us)
+{
+    bus_sleep_us += us;
+    bus_time_us += us;
+    return 0;
+}
+
+unsigned int __wrap_sleep(unsigned int seconds)
+{
+    return 0;
+}
+
+// A fixed pseudo-random sequence, the same with every C library
+static uint32_t sparse_seed = 1;
+
+static uint32_t sparse_next(uint32_t range)
+{
+    sparse_seed = sparse_seed * 1103515245 + 12345;
+    return (sparse_seed >> 16) % range;
+}
+
+static void report(const char *what, uint32_t count)
+{
+    printf("%-8s transactions %7.1f  messages %7.1f  bytes %8.1f  pacing %9.1f us  bus time %9.1f us\n", what,
+           (double)bus_transactions / count, (double)bus_messages / count, (double)bus_bytes / count,
+           (double)bus_sleep_us / count, bus_time_us / count);
+    bus_transactions = bus_messages = bus_bytes = bus_sleep_us = 0;
+    bus_time_us = 0;
+}
+
+#ifdef LCD_COST_BYTE_NS
+/**
+ * @brief Compare the cost model's prediction with the bus time counted here.
+ *
+ * Call before report(), which clears the bus time.
+ *
+ * @return void
+ */
+static void report_plans(void)
+{
+    static const char *planNames[LCD_PLAN_COUNT] = {"full", "tiles", "rects", "pixels"};
+    PlanStats plans;
+    uint64_t predicted = 0;
+    uint32_t frames = 0;
+    uint8_t i = 0;
+
+    lcd_get_plan_stats(&plans);
+    for (i = 0; i < LCD_PLAN_COUNT; i++)
+    {
+        frames += plans.frames[i];
+        predicted += plans.predicted_us[i];
+    }
+    for (i = 0; i < LCD_PLAN_COUNT; i++)
+    {
+        if (plans.frames[i] > 0)
+            printf("plan %-6s %5.1f%% of frames\n", planNames[i], 100.0 * plans.frames[i] / frames);
+    }
+    printf("predicted bus time %.1f us, counted %.1f us, error %+.3f%%\n", (double)predicted, bus_time_us,
+           100.0 * (predicted - bus_time_us) / bus_time_us);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    static FontDef *fonts[] = {&Font_7x10, &Font_8x16, &Font_11x18, &Font_16x26};
+    static const char *names[] = {"7x10", "8x16", "11x18", "16x26"};
+    uint32_t count = (argc > 2) ? strtoul(argv[2], NULL, 10) : 0;
+    uint32_t i = 0;
+    uint8_t f = 0;
+
+    if ((argc != 3) || (count == 0) || (strcmp(argv[1], "pages") && strcmp(argv[1], "glyphs") && strcmp(argv[1], "sparse")))
+    {
+        fprintf(stderr, "Usage: %s pages|glyphs|sparse N\n", argv[0]);
+        return 1;
+    }
+    if (lcd_begin())
+        return 1;
+
+    if (strcmp(argv[1], "pages") == 0)
+    {
+        // the first page pays for the initial full-screen draw
+        lcd_display(0);
+        report("first", 1);
+        for (i = 0; i < count; i++)
+        {
+            lcd_display(i % LCD_PAGE_COUNT);
+        }
+        report("page", count);
+        return 0;
+    }
+
+    // the first flush sends the whole screen; keep it out of the glyph figures
+    if (lcd_flush)
+        lcd_flush();
+    report("screen", 1);
+
+    if (strcmp(argv[1], "sparse") == 0)
+    {
+#ifdef LCD_COST_BYTE_NS
+        lcd_reset_bus_stats();
+#endif
+        for (i = 0; i < count; i++)
+        {
+            // one to four specks of up to 3x2 pixels anywhere on the screen
+            for (f = sparse_next(4) + 1; f > 0; f--)
+            {
+                lcd_fill_rectangle(sparse_next(ST7735_WIDTH - 3), sparse_next(ST7735_HEIGHT - 2), sparse_next(3) + 1,
+                                   sparse_next(2) + 1, sparse_next(0x10000));
+            }
+            if (lcd_flush)
+                lcd_flush();
+        }
+#ifdef LCD_COST_BYTE_NS
+        report_plans();
+#endif
+        report("frame", count);
+        return 0;
+    }
+    for (f = 0; f < sizeof(fonts) / sizeof(fonts[0]); f++)
+    {
+        for (i = 0; i < count; i++)
+        {
+            // alternate the colors so a diffing driver cannot skip the glyph
+            lcd_write_string(0, 0, "%", *fonts[f], (i & 1) ? ST7735_WHITE : ST7735_YELLOW, ST7735_BLACK);
+            if (lcd_flush)
+                lcd_flush();
+        }
+        report(names[f], count);
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#!/bin/sh
+# Bus usage per page, per glyph and per sparse frame of this tree, and optionally of another
+# revision for comparison, measured by tests/busbench.c without hardware.
+#
+#   tests/busstats.sh [N] [BASE] [REV]
+#
+# N defaults to 60. BASE and REV are git revisions, e.g. a commit and its
+# parent; each is checked out into a temporary worktree and built with the
+# busbench.c of this tree. Without REV the working tree is measured.
+set -e
+
+N=${1:-60}
+BASE=$2
+REV=$3
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'for w in "$TMP"/base "$TMP"/rev; do [ -d "$w" ] && git -C "$ROOT" worktree remove --force "$w"; done; rm -rf "$TMP"' EXIT
+
+build() {
+	# $1 source tree, $2 output binary
+	gcc -O2 -w -I "$1/hardware/st7735" -I "$1/hardware/rpiInfo" -o "$2" "$ROOT/tests/busbench.c" \
+		"$1"/hardware/st7735/*.c "$1"/hardware/rpiInfo/*.c \
+		-Wl,--wrap=open,--wrap=write,--wrap=ioctl,--wrap=usleep,--wrap=sleep -lm -lpthread
+}
+
+run() {
+	# $1 label, $2 binary
+	echo "== $1"
+	"$2" pages "$N" 2>/dev/null
+	"$2" glyphs "$N" 2>/dev/null
+	"$2" sparse "$((N * 50))" 2>/dev/null
+}
+
+if [ -n "$BASE" ]; then
+	git -C "$ROOT" worktree add --detach -q "$TMP/base" "$BASE"
+	build "$TMP/base" "$TMP/busbench-base"
+	run "$BASE" "$TMP/busbench-base"
+fi
+if [ -n "$REV" ]; then
+	git -C "$ROOT" worktree add --detach -q "$TMP/rev" "$REV"
+	build "$TMP/rev" "$TMP/busbench"
+	run "$REV" "$TMP/busbench"
+else
+	build "$ROOT" "$TMP/busbench"
+	run "working tree" "$TMP/busbench"
+fi
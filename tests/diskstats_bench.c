@@ -0,0 +1,153 @@
+/*
+ * DiskStatsSample() on captured /proc/diskstats files with hundreds of lines.
+ *
+ * Includes diskstats.c to point its ProcFile at the fixtures. The fixtures
+ * hold 300 loop devices and three disks from DISK_DEVICES with 39 partitions
+ * each; proc_diskstats.next is the same system a little later.
+ *
+ *   diskstats_bench           time DiskStatsSample() against fgets + sscanf
+ *   diskstats_bench --check   check rates and latency between the two files
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "diskstats.c"
+
+#define ROUNDS 2000
+#define FIXTURE "tests/fixtures/proc_diskstats"
+#define FIXTURE_NEXT "tests/fixtures/proc_diskstats.next"
+
+// Read and write latency the fixtures imply for each disk, in microseconds
+static const struct
+{
+  const char *name;
+  uint32_t readAwaitUs;
+  uint32_t writeAwaitUs;
+} expectedAwait[] = {
+    {"mmcblk0", 250 * 1000 / 100, 600 * 1000 / 50},
+    {"nvme0n1", 500 * 1000 / 101, 1200 * 1000 / 50},
+    {"sda", 750 * 1000 / 102, 1800 * 1000 / 50},
+};
+
+static void Sample(const char *path)
+{
+  ProcFileClose(&procDiskstats);
+  procDiskstats.path = path;
+  DiskStatsSample();
+}
+
+// What a collector reading the file with stdio would do for the same devices
+static uint8_t OldSample(const char *path)
+{
+  char line[256];
+  char name[DISKSTATS_NAME_MAX];
+  unsigned long long f[10];
+  uint8_t found = 0;
+  uint8_t i = 0;
+  FILE *fd = fopen(path, "r");
+
+  if (fd == NULL)
+  {
+    return 0;
+  }
+  while (fgets(line, sizeof(line), fd) != NULL)
+  {
+    if (sscanf(line, "%*u %*u %31s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu", name,
+               &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7], &f[8], &f[9]) != 11)
+    {
+      continue;
+    }
+    for (i = 0; i < diskCount; i++)
+    {
+      if (strcmp(name, disks[i].name) == 0)
+      {
+        found++;
+      }
+    }
+  }
+  fclose(fd);
+  return found;
+}
+
+static int Check(void)
+{
+  DiskStats stats;
+  uint32_t failures = 0;
+  uint8_t i = 0;
+  uint8_t d = 0;
+
+  Sample(FIXTURE);
+  Sample(FIXTURE_NEXT);
+  for (i = 0; i < sizeof(expectedAwait) / sizeof(expectedAwait[0]); i++)
+  {
+    for (d = 0; DiskStatsGet(d, &stats) == 0; d++)
+    {
+      if (strcmp(stats.name, expectedAwait[i].name) == 0)
+      {
+        break;
+      }
+    }
+    if (!stats.present || (strcmp(stats.name, expectedAwait[i].name) != 0))
+    {
+      fprintf(stderr, "diskstats: %s not found\n", expectedAwait[i].name);
+      failures++;
+      continue;
+    }
+    if ((stats.readAwaitUs != expectedAwait[i].readAwaitUs) || (stats.writeAwaitUs != expectedAwait[i].writeAwaitUs) ||
+        (stats.readIops == 0) || (stats.writeBytesRate == 0))
+    {
+      fprintf(stderr, "diskstats: %s await %u/%u us, expected %u/%u us, %u read IOPS, %llu B/s written\n", stats.name,
+              stats.readAwaitUs, stats.writeAwaitUs, expectedAwait[i].readAwaitUs, expectedAwait[i].writeAwaitUs,
+              stats.readIops, (unsigned long long)stats.writeBytesRate);
+      failures++;
+      continue;
+    }
+    printf("diskstats: %s await R %u us W %u us\n", stats.name, stats.readAwaitUs, stats.writeAwaitUs);
+  }
+
+  // going back to the older file looks like re-created devices: no rates, no latency
+  Sample(FIXTURE);
+  for (d = 0; DiskStatsGet(d, &stats) == 0; d++)
+  {
+    if (stats.readAwaitUs || stats.writeAwaitUs || stats.readIops || stats.writeIops)
+    {
+      fprintf(stderr, "diskstats: %s has rates after its counters went backwards\n", stats.name);
+      failures++;
+    }
+  }
+  return failures ? 1 : 0;
+}
+
+static double Elapsed(const struct timespec *start, const struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+int main(int argc, char *argv[])
+{
+  struct timespec start, end;
+  uint32_t i = 0;
+
+  if ((argc > 1) && (strcmp(argv[1], "--check") == 0))
+  {
+    return Check();
+  }
+
+  Sample(FIXTURE);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ROUNDS; i++)
+  {
+    DiskStatsSample();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  printf("DiskStatsSample()                  %8.1f us\n", Elapsed(&start, &end) / ROUNDS / 1000);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ROUNDS; i++)
+  {
+    OldSample(FIXTURE);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  printf("fopen + fgets + sscanf every line  %8.1f us\n", Elapsed(&start, &end) / ROUNDS / 1000);
+  return 0;
+}
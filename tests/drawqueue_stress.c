@@ -0,0 +1,229 @@
+/*
+ * Stress test of the draw command queue, meant to run under TSAN.
+ *
+ * Links drawqueue.c alone; the st7735 drawing calls it makes are replaced by
+ * stubs that check what arrives. First the ring is filled single-threaded to
+ * check that a post into a full ring fails, is counted and loses nothing.
+ * Then PRODUCERS threads post numbered fill and text commands, retrying
+ * while the ring is full, with a flush request every FLUSH_EVERY commands;
+ * the main thread consumes them as display.c does, through draw_queue_fd()
+ * and draw_queue_run(). Every command must be applied exactly once and each
+ * producer's in order.
+ *
+ *   drawqueue_stress [COMMANDS]   commands per producer, default 20000
+ */
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "drawqueue.h"
+#include "st7735.h"
+
+#define PRODUCERS 4
+#define FLUSH_EVERY 97
+
+static uint32_t commands = 20000;
+// Consumer side: next command expected from each producer
+static uint32_t expected[PRODUCERS];
+static uint32_t applied = 0;
+static uint32_t errors = 0;
+static uint32_t flushes = 0;
+// Producer side
+static _Atomic uint32_t retries = 0;
+static _Atomic uint32_t flushRequests = 0;
+
+static void deliver(uint32_t producer, uint32_t seq)
+{
+    if ((producer >= PRODUCERS) || (seq != expected[producer]))
+    {
+        if (errors++ < 10)
+            fprintf(stderr, "drawqueue: producer %u sent %u, expected %u\n", producer, seq,
+                    (producer < PRODUCERS) ? expected[producer] : 0);
+        return;
+    }
+    expected[producer]++;
+    applied++;
+}
+
+// fills carry the producer in x and the sequence number in y (low) and w (high)
+void lcd_fill_rectangle(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+    deliver(x, ((uint32_t)w << 16) | y);
+}
+
+// text commands carry both in the string
+void lcd_write_str(uint16_t x, uint16_t y, char *str, FontType font, uint16_t color, uint16_t bgcolor)
+{
+    uint32_t producer = 0;
+    uint32_t seq = 0;
+
+    if (sscanf(str, "p%u #%u", &producer, &seq) != 2)
+    {
+        fprintf(stderr, "drawqueue: garbled text command \"%s\"\n", str);
+        errors++;
+        return;
+    }
+    deliver(producer, seq);
+}
+
+void lcd_draw_image(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data)
+{
+    fprintf(stderr, "drawqueue: unexpected blit\n");
+    errors++;
+}
+
+void lcd_flush(void)
+{
+    flushes++;
+}
+
+static uint8_t post(uint32_t producer, uint32_t seq)
+{
+    char text[DRAW_QUEUE_TEXT_MAX];
+
+    if (seq & 1)
+    {
+        snprintf(text, sizeof(text), "p%u #%u", producer, seq);
+        return draw_queue_text(0, 0, text, FontType_7x10, ST7735_WHITE, ST7735_BLACK);
+    }
+    return draw_queue_fill(producer, seq & 0xFFFF, seq >> 16, 1, ST7735_WHITE);
+}
+
+static void *producer_main(void *arg)
+{
+    uint32_t producer = (uint32_t)(uintptr_t)arg;
+    uint32_t seq = 0;
+
+    for (seq = 0; seq < commands; seq++)
+    {
+        // a full ring rejects the post; the command is posted again, not lost
+        while (post(producer, seq))
+        {
+            atomic_fetch_add_explicit(&retries, 1, memory_order_relaxed);
+            sched_yield();
+        }
+        if ((seq % FLUSH_EVERY) == FLUSH_EVERY - 1)
+        {
+            while (draw_queue_flush())
+            {
+                atomic_fetch_add_explicit(&retries, 1, memory_order_relaxed);
+                sched_yield();
+            }
+            atomic_fetch_add_explicit(&flushRequests, 1, memory_order_relaxed);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Fill the ring from one thread, over several laps.
+ *
+ * @return Number of failures.
+ */
+static uint32_t check_full(void)
+{
+    uint32_t failures = 0;
+    uint32_t lap = 0;
+    uint32_t i = 0;
+
+    for (lap = 0; lap < 3; lap++)
+    {
+        for (i = 0; i < DRAW_QUEUE_SLOTS; i++)
+        {
+            if (post(0, expected[0] + i))
+            {
+                fprintf(stderr, "drawqueue: post %u of %u rejected\n", i, DRAW_QUEUE_SLOTS);
+                failures++;
+            }
+        }
+        if (post(0, expected[0] + DRAW_QUEUE_SLOTS) == 0)
+        {
+            fprintf(stderr, "drawqueue: post into a full ring accepted\n");
+            failures++;
+        }
+        if (draw_queue_apply() != 0)
+        {
+            fprintf(stderr, "drawqueue: flush reported without a request\n");
+            failures++;
+        }
+        if (applied != (lap + 1) * DRAW_QUEUE_SLOTS)
+        {
+            fprintf(stderr, "drawqueue: %u of %u commands applied\n", applied, (lap + 1) * DRAW_QUEUE_SLOTS);
+            failures++;
+        }
+    }
+    if (draw_queue_dropped() != 3)
+    {
+        fprintf(stderr, "drawqueue: %u drops counted, 3 expected\n", draw_queue_dropped());
+        failures++;
+    }
+    memset(expected, 0, sizeof(expected));
+    applied = 0;
+    return failures + errors;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t producers[PRODUCERS];
+    struct pollfd pfd;
+    uint32_t total = 0;
+    uint32_t failures = 0;
+    uint32_t dropped = 0;
+    uint32_t i = 0;
+
+    if (argc > 1)
+        commands = strtoul(argv[1], NULL, 10);
+
+    failures = check_full();
+    dropped = draw_queue_dropped();
+
+    pfd.fd = draw_queue_fd();
+    pfd.events = POLLIN;
+    if (pfd.fd < 0)
+        return 1;
+    for (i = 0; i < PRODUCERS; i++)
+        pthread_create(&producers[i], NULL, producer_main, (void *)(uintptr_t)i);
+
+    total = PRODUCERS * commands;
+    while (applied < total)
+    {
+        // woken by flush requests; in between, pick up what is there
+        if (poll(&pfd, 1, 1) > 0)
+            draw_queue_run();
+        else
+            draw_queue_apply();
+        if (errors > 0)
+            break;
+    }
+    for (i = 0; i < PRODUCERS; i++)
+        pthread_join(producers[i], NULL);
+    // flush requests posted after the last command
+    draw_queue_run();
+
+    for (i = 0; i < PRODUCERS; i++)
+    {
+        if (expected[i] != commands)
+        {
+            fprintf(stderr, "drawqueue: producer %u: %u of %u commands applied\n", i, expected[i], commands);
+            failures++;
+        }
+    }
+    if ((atomic_load(&flushRequests) > 0) && (flushes == 0))
+    {
+        fprintf(stderr, "drawqueue: %u flush requests, none honoured\n", atomic_load(&flushRequests));
+        failures++;
+    }
+    if (draw_queue_dropped() - dropped != atomic_load(&retries))
+    {
+        fprintf(stderr, "drawqueue: %u rejected posts, %u drops counted\n", atomic_load(&retries), draw_queue_dropped() - dropped);
+        failures++;
+    }
+    failures += errors;
+
+    printf("drawqueue: %u producers x %u commands, applied %u once each in order, %u flushes for %u requests, %u posts retried on a full ring\n",
+           PRODUCERS, commands, applied, flushes, atomic_load(&flushRequests), atomic_load(&retries));
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Microbenchmark and parity check of the 1bpp-to-RGB565 expansion kernels.
+ *
+ * Includes expand.c to reach every kernel built for this target, not just
+ * the one expand_mask16() dispatches to.
+ *
+ *   expand_bench          pixels per ns of each kernel for the four fonts
+ *   expand_bench --check  compare each kernel with expand_scalar(), exit 1 on a mismatch
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fonts.h"
+#include "expand.c"
+
+#define GLYPHS 95
+#define BENCH_ROUNDS 2000
+// Guard bytes after the destination, catching stores past the last row
+#define GUARD 64
+
+typedef struct
+{
+    const char *name;
+    ExpandFn fn;
+} Kernel;
+
+static Kernel kernels[4];
+static uint8_t kernelCount = 0;
+
+static void add_kernels(void)
+{
+    kernels[kernelCount++] = (Kernel){"scalar", expand_scalar};
+#if defined(__SSE2__)
+    kernels[kernelCount++] = (Kernel){"sse2", expand_sse2};
+#endif
+#if defined(EXPAND_HAVE_AVX2)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        kernels[kernelCount++] = (Kernel){"avx2", expand_avx2};
+#endif
+#if defined(__ARM_NEON)
+    kernels[kernelCount++] = (Kernel){"neon", expand_neon};
+#endif
+}
+
+/**
+ * @brief Expand the same rows with a kernel and with expand_scalar() and compare.
+ *
+ * Both destinations start out filled with the same pattern and are compared
+ * whole, guard bytes included, so a store outside the glyph is a mismatch
+ * too.
+ *
+ * @return 1 if the outputs differ, 0 otherwise.
+ */
+static uint8_t check_one(const Kernel *k, const uint16_t *rows, uint16_t count, uint8_t width, uint32_t stride)
+{
+    static uint8_t want[26 * 64 + GUARD];
+    static uint8_t got[26 * 64 + GUARD];
+    uint32_t size = (count - 1) * stride + width * 2 + GUARD;
+
+    memset(want, 0xA5, size);
+    memset(got, 0xA5, size);
+    expand_scalar(rows, count, width, 0xF81F, 0x07E0, want, stride);
+    k->fn(rows, count, width, 0xF81F, 0x07E0, got, stride);
+    if (memcmp(want, got, size) != 0)
+    {
+        fprintf(stderr, "%s: mismatch at width %u, %u rows, stride %u\n", k->name, width, count, stride);
+        return 1;
+    }
+    return 0;
+}
+
+static int check(void)
+{
+    static const FontDef *fonts[] = {&Font_7x10, &Font_8x16, &Font_11x18, &Font_16x26};
+    uint16_t rows[26];
+    uint32_t strides[3];
+    uint32_t failures = 0;
+    uint32_t cases = 0;
+    uint16_t g = 0;
+    uint16_t count = 0;
+    uint8_t width = 0;
+    uint8_t f = 0;
+    uint8_t k = 0;
+    uint8_t s = 0;
+
+    srand(1);
+    for (k = 1; k < kernelCount; k++)
+    {
+        // every glyph of every font, packed and inside a framebuffer-wide row
+        for (f = 0; f < sizeof(fonts) / sizeof(fonts[0]); f++)
+        {
+            for (g = 0; g < GLYPHS; g++)
+            {
+                failures += check_one(&kernels[k], fonts[f]->data + g * fonts[f]->height, fonts[f]->height, fonts[f]->width, fonts[f]->width * 2);
+                failures += check_one(&kernels[k], fonts[f]->data + g * fonts[f]->height, fonts[f]->height, fonts[f]->width, 64);
+                cases += 2;
+            }
+        }
+        // random rows, with bits set past the width, at every width and packed or padded strides
+        for (width = 1; width <= 16; width++)
+        {
+            strides[0] = width * 2;
+            strides[1] = width * 2 + 2;
+            strides[2] = 64;
+            for (count = 1; count <= 26; count++)
+            {
+                for (s = 0; s < 3; s++)
+                {
+                    for (g = 0; g < count; g++)
+                        rows[g] = rand();
+                    failures += check_one(&kernels[k], rows, count, width, strides[s]);
+                    cases++;
+                }
+            }
+        }
+        printf("%s: %u cases against scalar\n", kernels[k].name, cases);
+        cases = 0;
+    }
+    if (kernelCount == 1)
+        printf("scalar only, nothing to compare\n");
+    return failures ? 1 : 0;
+}
+
+static void bench(void)
+{
+    static const FontDef *fonts[] = {&Font_7x10, &Font_8x16, &Font_11x18, &Font_16x26};
+    static const char *names[] = {"7x10", "8x16", "11x18", "16x26"};
+    static uint8_t dst[16 * 26 * 2];
+    struct timespec start, end;
+    double ns = 0;
+    uint32_t round = 0;
+    uint16_t g = 0;
+    uint8_t f = 0;
+    uint8_t k = 0;
+
+    printf("pixels/ns  ");
+    for (k = 0; k < kernelCount; k++)
+        printf("%8s", kernels[k].name);
+    printf("\n");
+    for (f = 0; f < sizeof(fonts) / sizeof(fonts[0]); f++)
+    {
+        printf("%-9s  ", names[f]);
+        for (k = 0; k < kernelCount; k++)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            for (round = 0; round < BENCH_ROUNDS; round++)
+            {
+                for (g = 0; g < GLYPHS; g++)
+                    kernels[k].fn(fonts[f]->data + g * fonts[f]->height, fonts[f]->height, fonts[f]->width,
+                                  round, ~round, dst, fonts[f]->width * 2);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+            printf("%8.2f", (double)BENCH_ROUNDS * GLYPHS * fonts[f]->width * fonts[f]->height / ns);
+        }
+        printf("\n");
+    }
+    // keep the stores from being optimized away
+    if (dst[0] == 0x5A && dst[1] == 0x5A)
+        printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    add_kernels();
+    if ((argc > 1) && (strcmp(argv[1], "--check") == 0))
+        return check();
+    bench();
+    return 0;
+}
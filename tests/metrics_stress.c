@@ -0,0 +1,123 @@
+/*
+ * Torn-read stress test of the metrics seqlock, meant to run under TSAN.
+ *
+ * One writer publishes snapshots whose fields are all derived from one
+ * counter, from the first byte of the hostname to the last of the disk
+ * statistics; READERS threads read them back and check that every field
+ * comes from the same snapshot and that no reader ever goes back in time.
+ *
+ *   metrics_stress [SNAPSHOTS]   snapshots to publish, default 100000
+ */
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "metrics.h"
+
+#define READERS 3
+
+static uint32_t snapshots = 100000;
+static _Atomic int writerDone = 0;
+static _Atomic uint32_t torn = 0;
+
+/**
+ * @brief Fill a snapshot from a counter.
+ *
+ * @param m Snapshot.
+ * @param k Counter.
+ * @return void
+ */
+static void Derive(Metrics *m, uint32_t k)
+{
+  uint8_t i = 0;
+
+  memset(m, (int)(k & 0xFF), sizeof(*m));
+  snprintf(m->hostname, sizeof(m->hostname), "node-%u", k);
+  m->cpuUsage = k % 101;
+  m->temperature = k % 97;
+  for (i = 0; i < FS_MOUNT_MAX; i++)
+  {
+    m->fs[i].usedKB = (uint64_t)k * (i + 1);
+  }
+  m->net.rxBytes = k;
+  m->net.txBytes = (uint64_t)k << 32;
+  m->linkSpeed = -(int32_t)k;
+  m->disk.reads = (uint64_t)k * 3;
+  m->diskPresent = k & 1;
+}
+
+static void *Reader(void *arg)
+{
+  Metrics m, want;
+  uint32_t last = 0;
+  uint32_t seq = 0;
+  uint32_t reads = 0;
+  uint32_t k = 0;
+
+  while (!atomic_load_explicit(&writerDone, memory_order_acquire))
+  {
+    seq = MetricsRead(&m);
+    reads++;
+    if (seq < last)
+    {
+      fprintf(stderr, "metrics: snapshot %u read after %u\n", seq, last);
+      atomic_fetch_add(&torn, 1);
+    }
+    last = seq;
+    if (seq == 0)
+    {
+      continue;
+    }
+    // the counter the writer used, then every other field must follow from it
+    k = m.net.rxBytes;
+    Derive(&want, k);
+    if (memcmp(&m, &want, sizeof(m)) != 0)
+    {
+      if (atomic_fetch_add(&torn, 1) < 10)
+      {
+        fprintf(stderr, "metrics: torn snapshot, rxBytes %u, hostname %.16s\n", k, m.hostname);
+      }
+    }
+  }
+  *(uint32_t *)arg = reads;
+  return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+  pthread_t readers[READERS];
+  uint32_t reads[READERS] = {0};
+  Metrics m;
+  uint32_t k = 0;
+  uint32_t i = 0;
+
+  if (argc > 1)
+  {
+    snapshots = strtoul(argv[1], NULL, 10);
+  }
+
+  for (i = 0; i < READERS; i++)
+  {
+    pthread_create(&readers[i], NULL, Reader, &reads[i]);
+  }
+  for (k = 1; k <= snapshots; k++)
+  {
+    Derive(&m, k);
+    MetricsPublish(&m);
+  }
+  atomic_store_explicit(&writerDone, 1, memory_order_release);
+  for (i = 0; i < READERS; i++)
+  {
+    pthread_join(readers[i], NULL);
+  }
+
+  if (MetricsRead(&m) != snapshots)
+  {
+    fprintf(stderr, "metrics: %u snapshots published, sequence says %u\n", snapshots, MetricsRead(&m));
+    atomic_fetch_add(&torn, 1);
+  }
+  printf("metrics: %u snapshots, %u readers made %u/%u/%u reads, %u torn\n", snapshots, READERS, reads[0], reads[1],
+         reads[2], atomic_load(&torn));
+  return atomic_load(&torn) ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+#ifndef __TESTS_ARM_NEON_H__
+#define __TESTS_ARM_NEON_H__
+
+/*
+ * Plain C stand-ins for the NEON intrinsics expand.c uses, with the lane
+ * semantics of the ARM ones, so "make check" can run expand_neon() against
+ * the scalar kernel on hosts without NEON. On ARM the real <arm_neon.h> is
+ * used and this directory is not on the include path.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+typedef struct
+{
+    uint16_t lane[8];
+} uint16x8_t;
+
+typedef struct
+{
+    uint8_t lane[16];
+} uint8x16_t;
+
+static inline uint16x8_t vdupq_n_u16(uint16_t value)
+{
+    uint16x8_t r;
+    int i = 0;
+
+    for (i = 0; i < 8; i++)
+        r.lane[i] = value;
+    return r;
+}
+
+static inline uint16x8_t vld1q_u16(const uint16_t *p)
+{
+    uint16x8_t r;
+
+    memcpy(r.lane, p, sizeof(r.lane));
+    return r;
+}
+
+// all ones where a & b has any bit set
+static inline uint16x8_t vtstq_u16(uint16x8_t a, uint16x8_t b)
+{
+    uint16x8_t r;
+    int i = 0;
+
+    for (i = 0; i < 8; i++)
+        r.lane[i] = (a.lane[i] & b.lane[i]) ? 0xFFFF : 0;
+    return r;
+}
+
+// bits of a where mask is set, of b elsewhere
+static inline uint16x8_t vbslq_u16(uint16x8_t mask, uint16x8_t a, uint16x8_t b)
+{
+    uint16x8_t r;
+    int i = 0;
+
+    for (i = 0; i < 8; i++)
+        r.lane[i] = (mask.lane[i] & a.lane[i]) | (~mask.lane[i] & b.lane[i]);
+    return r;
+}
+
+static inline uint8x16_t vreinterpretq_u8_u16(uint16x8_t v)
+{
+    uint8x16_t r;
+
+    memcpy(r.lane, v.lane, sizeof(r.lane));
+    return r;
+}
+
+static inline void vst1q_u16(uint16_t *p, uint16x8_t v)
+{
+    memcpy(p, v.lane, sizeof(v.lane));
+}
+
+static inline void vst1q_u8(uint8_t *p, uint8x16_t v)
+{
+    memcpy(p, v.lane, sizeof(v.lane));
+}
+
+#endif // __TESTS_ARM_NEON_H__
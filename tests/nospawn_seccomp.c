@@ -0,0 +1,155 @@
+/*
+ * Run a program under a seccomp filter that forbids creating processes.
+ *
+ *   nospawn_seccomp PROGRAM [ARGS...]
+ *
+ * nospawn.h catches popen() and friends at compile time in the collectors;
+ * this catches them at run time anywhere in the binary, including libraries.
+ * fork, vfork, execve other than the one starting PROGRAM, execveat, and
+ * clone without CLONE_THREAD raise SIGSYS; threads are still allowed.
+ * clone3 fails with ENOSYS, since its flags cannot be inspected, and the C
+ * library falls back to clone. Exits 1 if PROGRAM was killed by SIGSYS,
+ * otherwise with PROGRAM's own status.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#if defined(__x86_64__)
+#define NOSPAWN_ARCH AUDIT_ARCH_X86_64
+#elif defined(__aarch64__)
+#define NOSPAWN_ARCH AUDIT_ARCH_AARCH64
+#elif defined(__arm__)
+#define NOSPAWN_ARCH AUDIT_ARCH_ARM
+#elif defined(__i386__)
+#define NOSPAWN_ARCH AUDIT_ARCH_I386
+#else
+#error "nospawn_seccomp: unsupported architecture"
+#endif
+
+// 32-bit halves of a syscall argument in struct seccomp_data
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define ARG_LO(n) (offsetof(struct seccomp_data, args[n]) + 4)
+#define ARG_HI(n) offsetof(struct seccomp_data, args[n])
+#else
+#define ARG_LO(n) offsetof(struct seccomp_data, args[n])
+#define ARG_HI(n) (offsetof(struct seccomp_data, args[n]) + 4)
+#endif
+
+#define TRAP_IF(nr) BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (nr), 0, 1), BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP)
+
+/**
+ * @brief Install the filter on the calling thread and its future children.
+ *
+ * @param path The one execve() path pointer let through, to start the program.
+ * @return 0 on success, -1 on failure.
+ */
+static int install_filter(const char *path)
+{
+    uint64_t allowed = (uintptr_t)path;
+    struct sock_filter filter[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, NOSPAWN_ARCH, 1, 0),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr)),
+#ifdef __NR_fork
+        TRAP_IF(__NR_fork),
+#endif
+#ifdef __NR_vfork
+        TRAP_IF(__NR_vfork),
+#endif
+#ifdef __NR_execveat
+        TRAP_IF(__NR_execveat),
+#endif
+#ifdef __NR_clone3
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_clone3, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ERRNO | ENOSYS),
+#endif
+        // clone: threads only
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_clone, 0, 4),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ARG_LO(0)),
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, CLONE_THREAD, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+        // execve: only the one starting the program
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_execve, 0, 6),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ARG_LO(0)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)allowed, 0, 3),
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ARG_HI(0)),
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)(allowed >> 32), 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRAP),
+        BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW),
+    };
+    struct sock_fprog prog = {sizeof(filter) / sizeof(filter[0]), filter};
+
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0)
+    {
+        perror("nospawn_seccomp: PR_SET_NO_NEW_PRIVS");
+        return -1;
+    }
+    if (prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) < 0)
+    {
+        perror("nospawn_seccomp: PR_SET_SECCOMP");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    pid_t child = 0;
+    int status = 0;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s PROGRAM [ARGS...]\n", argv[0]);
+        return 2;
+    }
+
+    child = fork();
+    if (child < 0)
+    {
+        perror("nospawn_seccomp: fork");
+        return 2;
+    }
+    if (child == 0)
+    {
+        if (install_filter(argv[1]) < 0)
+            _exit(2);
+        execv(argv[1], argv + 1);
+        perror("nospawn_seccomp: execv");
+        _exit(2);
+    }
+
+    while (waitpid(child, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            perror("nospawn_seccomp: waitpid");
+            return 2;
+        }
+    }
+    if (WIFSIGNALED(status) && (WTERMSIG(status) == SIGSYS))
+    {
+        fprintf(stderr, "nospawn_seccomp: %s tried to create a process\n", argv[1]);
+        return 1;
+    }
+    if (WIFSIGNALED(status))
+    {
+        fprintf(stderr, "nospawn_seccomp: %s killed by signal %d\n", argv[1], WTERMSIG(status));
+        return 1;
+    }
+    return WEXITSTATUS(status);
+}
@@ -0,0 +1,215 @@
+/*
+ * Render every page through the emu transport and compare with baseline dumps.
+ *
+ * Links the st7735 sources with a GetMetrics() that returns fixed snapshots
+ * instead of live metrics. Each page is shown with one snapshot, then again
+ * with another, so the second image also checks that widgets redraw only
+ * what changed and leave nothing stale behind. After every page the panel
+ * the emulator decoded from the wire is dumped as <page>.ppm and
+ * <page>.next.ppm.
+ *
+ *   page_render OUTDIR            write the images to OUTDIR
+ *   page_render OUTDIR BASEDIR    also compare them with the ones in BASEDIR
+ *
+ * tests/fixtures/pages holds the baseline; after an intended change to the
+ * pages, regenerate it with obj/page_render tests/fixtures/pages and look at
+ * the images before committing them.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emulator.h"
+#include "rpiInfo.h"
+#include "st7735.h"
+
+static const char *pageNames[LCD_PAGE_COUNT] = {"cpu", "ram", "temp", "disk", "net", "io"};
+static Metrics snapshot;
+
+void GetMetrics(Metrics *m)
+{
+    *m = snapshot;
+}
+
+static void first_snapshot(Metrics *m)
+{
+    memset(m, 0, sizeof(*m));
+    strcpy(m->hostname, "rpi-node");
+    m->cpuUsage = 42;
+    m->memoryPct = 63;
+    m->temperature = 51;
+    m->fsCount = 3;
+    strcpy(m->fs[0].mountPoint, "/");
+    m->fs[0].mounted = 1;
+    m->fs[0].usedPct = 71;
+    strcpy(m->fs[1].mountPoint, "/boot/firmware");
+    m->fs[1].mounted = 1;
+    m->fs[1].usedPct = 12;
+    strcpy(m->fs[2].mountPoint, "/mnt/data");
+    strcpy(m->ifname, "eth0");
+    strcpy(m->ipAddress, "192.168.1.42");
+    m->net.rxBytesRate = 1500000;
+    m->net.txBytesRate = 12000;
+    m->linkSpeed = 1000;
+    strcpy(m->disk.name, "mmcblk0");
+    m->disk.present = 1;
+    m->disk.readBytesRate = 2400000;
+    m->disk.writeBytesRate = 350000;
+    m->disk.readIops = 120;
+    m->disk.writeIops = 35;
+    m->disk.readAwaitUs = 1250;
+    m->disk.writeAwaitUs = 8400;
+    m->disk.utilPct = 37;
+    m->diskPresent = 1;
+}
+
+// every value the pages show changes, some to shorter text
+static void next_snapshot(Metrics *m)
+{
+    m->cpuUsage = 7;
+    m->memoryPct = 100;
+    m->temperature = 48;
+    m->fs[0].usedPct = 9;
+    m->fs[2].mounted = 1;
+    m->fs[2].usedPct = 88;
+    m->net.rxBytesRate = 900;
+    m->net.txBytesRate = 125000000;
+    m->disk.readBytesRate = 0;
+    m->disk.writeBytesRate = 51000000;
+    m->disk.readIops = 0;
+    m->disk.writeIops = 4100;
+    m->disk.readAwaitUs = 0;
+    m->disk.writeAwaitUs = 123456;
+    m->disk.utilPct = 100;
+}
+
+/**
+ * @brief Read a binary PPM image as written by emulator_dump_ppm().
+ *
+ * @param path Image file.
+ * @param width Set to the image width.
+ * @param height Set to the image height.
+ * @return RGB bytes, to be freed, or NULL on failure.
+ */
+static uint8_t *load_ppm(const char *path, unsigned *width, unsigned *height)
+{
+    FILE *fd = fopen(path, "rb");
+    uint8_t *rgb = NULL;
+    unsigned max = 0;
+
+    if (fd == NULL)
+    {
+        fprintf(stderr, "page_render: Unable to open %s\n", path);
+        return NULL;
+    }
+    if ((fscanf(fd, "P6 %u %u %u", width, height, &max) != 3) || (max != 255) || (fgetc(fd) != '\n'))
+    {
+        fprintf(stderr, "page_render: %s is not a binary PPM image\n", path);
+        fclose(fd);
+        return NULL;
+    }
+    rgb = malloc((size_t)*width * *height * 3);
+    if ((rgb != NULL) && (fread(rgb, 3, (size_t)*width * *height, fd) != (size_t)*width * *height))
+    {
+        fprintf(stderr, "page_render: %s is truncated\n", path);
+        free(rgb);
+        rgb = NULL;
+    }
+    fclose(fd);
+    return rgb;
+}
+
+/**
+ * @brief Compare a rendered image with its baseline pixel by pixel.
+ *
+ * @param path Rendered image.
+ * @param basePath Baseline image.
+ * @return Number of failures.
+ */
+static uint32_t compare(const char *path, const char *basePath)
+{
+    unsigned w = 0, h = 0, bw = 0, bh = 0;
+    uint8_t *rgb = load_ppm(path, &w, &h);
+    uint8_t *base = load_ppm(basePath, &bw, &bh);
+    uint32_t differ = 0;
+    unsigned first = 0;
+    unsigned i = 0;
+
+    if ((rgb == NULL) || (base == NULL) || (w != bw) || (h != bh))
+    {
+        if ((rgb != NULL) && (base != NULL))
+            fprintf(stderr, "page_render: %s is %ux%u, %s is %ux%u\n", path, w, h, basePath, bw, bh);
+        free(rgb);
+        free(base);
+        return 1;
+    }
+    for (i = 0; i < w * h; i++)
+    {
+        if (memcmp(rgb + i * 3, base + i * 3, 3) != 0)
+        {
+            if (differ++ == 0)
+                first = i;
+        }
+    }
+    free(rgb);
+    free(base);
+    if (differ > 0)
+    {
+        fprintf(stderr, "page_render: %s differs from %s in %u pixels, first at (%u, %u)\n", path, basePath, differ,
+                first % w, first / w);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *suffix[2] = {"", ".next"};
+    char path[256];
+    char basePath[256];
+    EmulatorStats stats;
+    uint32_t failures = 0;
+    uint8_t round = 0;
+    uint8_t page = 0;
+
+    if ((argc < 2) || (argc > 3))
+    {
+        fprintf(stderr, "Usage: %s OUTDIR [BASEDIR]\n", argv[0]);
+        return 2;
+    }
+
+    // the last panel lcd_end() saves is already among the pages
+    lcd_set_transport("emu:/dev/null");
+    if (lcd_begin())
+        return 1;
+    first_snapshot(&snapshot);
+    for (round = 0; round < 2; round++)
+    {
+        for (page = 0; page < LCD_PAGE_COUNT; page++)
+        {
+            lcd_display(page);
+            snprintf(path, sizeof(path), "%s/%s%s.ppm", argv[1], pageNames[page], suffix[round]);
+            if (emulator_dump_ppm(path))
+            {
+                failures++;
+                continue;
+            }
+            if (argc > 2)
+            {
+                snprintf(basePath, sizeof(basePath), "%s/%s%s.ppm", argv[2], pageNames[page], suffix[round]);
+                failures += compare(path, basePath);
+            }
+        }
+        next_snapshot(&snapshot);
+    }
+    emulator_get_stats(&stats);
+    if (stats.violations > 0)
+    {
+        fprintf(stderr, "page_render: %u protocol violations on the wire\n", stats.violations);
+        failures++;
+    }
+    lcd_end();
+
+    printf("page_render: %u pages rendered twice%s, %u failures\n", LCD_PAGE_COUNT,
+           (argc > 2) ? " and compared with the baseline" : "", failures);
+    return failures ? 1 : 0;
+}
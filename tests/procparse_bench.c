@@ -0,0 +1,205 @@
+/*
+ * Parity and speed of the /proc parsers in procfile.c against the stdio code
+ * they replaced (sscanf for /proc/stat, strtok_r + sscanf for /proc/meminfo),
+ * on captured files.
+ *
+ *   procparse_bench [--check] [STAT MEMINFO]
+ *
+ * The fixtures default to tests/fixtures/proc_stat and proc_meminfo. With
+ * --check only the outputs are compared; exit status 1 on a difference.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "procfile.h"
+
+#define ROUNDS 200000
+
+static char statBuf[PROCFILE_BUF_SIZE];
+static char meminfoBuf[PROCFILE_BUF_SIZE];
+
+static int LoadFixture(const char *path, char *buf)
+{
+  FILE *fd = fopen(path, "r");
+  size_t len = 0;
+
+  if (fd == NULL)
+  {
+    fprintf(stderr, "Unable to open %s\n", path);
+    return 1;
+  }
+  len = fread(buf, 1, PROCFILE_BUF_SIZE - 1, fd);
+  buf[len] = '\0';
+  fclose(fd);
+  return 0;
+}
+
+// ReadCPUStat() before the parsers: all ten columns or nothing
+static int OldCPUStat(const char *buf, uint64_t *fields)
+{
+  unsigned long int f[10] = {0};
+  int i = 0;
+
+  if (sscanf(buf, "cpu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
+             &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7], &f[8], &f[9]) != 10)
+  {
+    return 0;
+  }
+  for (i = 0; i < 10; i++)
+  {
+    fields[i] = f[i];
+  }
+  return 10;
+}
+
+// GetMemory() before the parsers; strtok_r() writes into the buffer, so it works on a copy
+static int OldMeminfo(const char *buf, uint64_t *memTotal, uint64_t *memFree)
+{
+  static char copy[PROCFILE_BUF_SIZE];
+  char key[100] = {0};
+  char *line, *linePtr;
+  unsigned int value = 0;
+  int found = 0;
+
+  strcpy(copy, buf);
+  for (line = strtok_r(copy, "\n", &linePtr); line != NULL; line = strtok_r(NULL, "\n", &linePtr))
+  {
+    if (sscanf(line, "%99s%u", key, &value) != 2)
+    {
+      continue;
+    }
+    if (strcmp(key, "MemTotal:") == 0)
+    {
+      *memTotal = value;
+      found++;
+    }
+    else if (strcmp(key, "MemFree:") == 0)
+    {
+      *memFree = value;
+      found++;
+    }
+  }
+  return found;
+}
+
+static int Check(void)
+{
+  static const char *const keys[] = {"MemTotal", "MemFree"};
+  uint64_t oldFields[10] = {0};
+  uint64_t newFields[10] = {0};
+  uint64_t oldMem[2] = {0};
+  uint64_t newMem[2] = {0};
+  int failures = 0;
+
+  if ((OldCPUStat(statBuf, oldFields) != 10) || (ParseCPUStat(statBuf, newFields, 10) != 10) ||
+      (memcmp(oldFields, newFields, sizeof(oldFields)) != 0))
+  {
+    fprintf(stderr, "/proc/stat: parsers disagree\n");
+    failures++;
+  }
+  if ((OldMeminfo(meminfoBuf, &oldMem[0], &oldMem[1]) != 2) || (ParseMeminfo(meminfoBuf, keys, newMem, 2) != 2) ||
+      (memcmp(oldMem, newMem, sizeof(oldMem)) != 0))
+  {
+    fprintf(stderr, "/proc/meminfo: parsers disagree\n");
+    failures++;
+  }
+  if (failures == 0)
+  {
+    printf("/proc/stat: cpu %llu %llu %llu %llu ..., same from both parsers\n",
+           (unsigned long long)newFields[0], (unsigned long long)newFields[1], (unsigned long long)newFields[2], (unsigned long long)newFields[3]);
+    printf("/proc/meminfo: MemTotal %llu kB, MemFree %llu kB, same from both parsers\n",
+           (unsigned long long)newMem[0], (unsigned long long)newMem[1]);
+  }
+  return failures ? 1 : 0;
+}
+
+static double Elapsed(const struct timespec *start, const struct timespec *end)
+{
+  return (end->tv_sec - start->tv_sec) * 1e9 + (end->tv_nsec - start->tv_nsec);
+}
+
+static void Bench(void)
+{
+  static const char *const keys[] = {"MemTotal", "MemFree"};
+  struct timespec start, end;
+  uint64_t fields[10] = {0};
+  uint64_t mem[2] = {0};
+  volatile uint64_t sink = 0;
+  uint32_t i = 0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ROUNDS; i++)
+  {
+    OldCPUStat(statBuf, fields);
+    sink += fields[0];
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  printf("/proc/stat     sscanf          %8.1f ns\n", Elapsed(&start, &end) / ROUNDS);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ROUNDS; i++)
+  {
+    ParseCPUStat(statBuf, fields, 10);
+    sink += fields[0];
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  printf("/proc/stat     ParseCPUStat    %8.1f ns\n", Elapsed(&start, &end) / ROUNDS);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ROUNDS; i++)
+  {
+    OldMeminfo(meminfoBuf, &mem[0], &mem[1]);
+    sink += mem[0];
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  printf("/proc/meminfo  strtok+sscanf   %8.1f ns\n", Elapsed(&start, &end) / ROUNDS);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < ROUNDS; i++)
+  {
+    ParseMeminfo(meminfoBuf, keys, mem, 2);
+    sink += mem[0];
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  printf("/proc/meminfo  ParseMeminfo    %8.1f ns\n", Elapsed(&start, &end) / ROUNDS);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *statPath = "tests/fixtures/proc_stat";
+  const char *meminfoPath = "tests/fixtures/proc_meminfo";
+  int check = 0;
+  int arg = 1;
+
+  if ((arg < argc) && (strcmp(argv[arg], "--check") == 0))
+  {
+    check = 1;
+    arg++;
+  }
+  if (arg + 2 == argc)
+  {
+    statPath = argv[arg];
+    meminfoPath = argv[arg + 1];
+  }
+  else if (arg != argc)
+  {
+    fprintf(stderr, "Usage: %s [--check] [STAT MEMINFO]\n", argv[0]);
+    return 2;
+  }
+  if (LoadFixture(statPath, statBuf) || LoadFixture(meminfoPath, meminfoBuf))
+  {
+    return 2;
+  }
+
+  if (check)
+  {
+    return Check();
+  }
+  if (Check())
+  {
+    return 1;
+  }
+  Bench();
+  return 0;
+}